@@ -0,0 +1,412 @@
+#include "columnar_vector.hpp"
+#include "segmented.hpp"
+#include "vector.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fmt/format.h>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// A plain-old-data element: trivially copyable, so shifts and splits use memmove/memcpy
+struct Point
+{
+    std::int32_t x = 0;
+    std::int32_t y = 0;
+    std::int32_t z = 0;
+    std::int32_t w = 0;
+};
+
+// Same layout as Point, but the user-provided assignment forces the element-by-element path
+struct TrackedPoint
+{
+    TrackedPoint() = default;
+    TrackedPoint(const TrackedPoint& other) = default;
+    TrackedPoint& operator=(const TrackedPoint& other)
+    {
+        x = other.x;
+        y = other.y;
+        z = other.z;
+        w = other.w;
+        return *this;
+    }
+
+    std::int32_t x = 0;
+    std::int32_t y = 0;
+    std::int32_t z = 0;
+    std::int32_t w = 0;
+};
+
+template <typename F>
+double timeSeconds(F&& work)
+{
+    auto start = std::chrono::steady_clock::now();
+    work();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Grows a vector to 'count' elements with random inserts, then drains it with random removes. The tree index finds the
+// bucket in O(log n), so with large buckets the time goes into shifting elements inside the bucket
+template <typename T, std::size_t BucketCapacity>
+void benchmarkInsertRemove(const std::string& name, std::size_t count)
+{
+    usu::vector<T, BucketCapacity, BucketCapacity, usu::tree_index<>> v;
+    std::mt19937 engine(42);
+
+    double insertSeconds = timeSeconds(
+        [&]()
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                std::uniform_int_distribution<std::size_t> position(0, v.size());
+                v.insert(position(engine), T());
+            }
+        });
+
+    double removeSeconds = timeSeconds(
+        [&]()
+        {
+            while (v.size() > 0)
+            {
+                std::uniform_int_distribution<std::size_t> position(0, v.size() - 1);
+                v.remove(position(engine));
+            }
+        });
+
+    std::cout << fmt::format("{:<36} insert: {:>12.0f} ops/s   remove: {:>12.0f} ops/s\n", name, count / insertSeconds, count / removeSeconds);
+}
+
+void benchmarkShifts(std::size_t count)
+{
+    std::cout << fmt::format("\n-- insert/remove throughput, {} elements --\n", count);
+    benchmarkInsertRemove<int, 512>("int, 512 (memmove)", count);
+    benchmarkInsertRemove<Point, 512>("Point, 512 (memmove)", count);
+    benchmarkInsertRemove<TrackedPoint, 512>("TrackedPoint, 512 (element-wise)", count);
+    benchmarkInsertRemove<int, 8192>("int, 8192 (memmove)", count);
+    benchmarkInsertRemove<Point, 8192>("Point, 8192 (memmove)", count);
+    benchmarkInsertRemove<TrackedPoint, 8192>("TrackedPoint, 8192 (element-wise)", count);
+}
+
+// Random positional inserts, lookups and removes on a large vector, which is where the bucket index matters
+template <typename Vector>
+void benchmarkIndex(const std::string& name, std::size_t count)
+{
+    Vector v;
+    std::mt19937 engine(7);
+
+    double insertSeconds = timeSeconds(
+        [&]()
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                std::uniform_int_distribution<std::size_t> position(0, v.size());
+                v.insert(position(engine), static_cast<int>(i));
+            }
+        });
+
+    long long sum = 0;
+    double lookupSeconds = timeSeconds(
+        [&]()
+        {
+            std::uniform_int_distribution<std::size_t> position(0, v.size() - 1);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                sum += v[position(engine)];
+            }
+        });
+
+    double removeSeconds = timeSeconds(
+        [&]()
+        {
+            while (v.size() > 0)
+            {
+                std::uniform_int_distribution<std::size_t> position(0, v.size() - 1);
+                v.remove(position(engine));
+            }
+        });
+
+    std::cout << fmt::format("{:<32} insert: {:>10.0f} ops/s   lookup: {:>10.0f} ops/s   remove: {:>10.0f} ops/s   (checksum {})\n",
+                             name, count / insertSeconds, count / lookupSeconds, count / removeSeconds, sum);
+}
+
+void benchmarkTree(std::size_t count)
+{
+    std::cout << fmt::format("\n-- flat vs tree bucket index, {} elements --\n", count);
+    benchmarkIndex<usu::vector<int, 64>>("flat_index", count);
+    benchmarkIndex<usu::vector<int, 64, 64, usu::tree_index<>>>("tree_index<16>", count);
+}
+
+// Random reads and a full map over a vector too large for the TLB to cover with 4 KiB pages
+template <typename Vector>
+void benchmarkRandomAccess(const std::string& name, std::size_t count)
+{
+    Vector v;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        v.add(static_cast<int>(i));
+    }
+    std::mt19937 engine(11);
+    std::uniform_int_distribution<std::size_t> position(0, v.size() - 1);
+
+    long long sum = 0;
+    double lookupSeconds = timeSeconds(
+        [&]()
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                sum += v[position(engine)];
+            }
+        });
+    double mapSeconds = timeSeconds([&]() { v.map([&sum](int& value) { sum += value; }); });
+
+    std::cout << fmt::format("{:<32} lookup: {:>10.0f} ops/s   map: {:>8.3f} s   (checksum {})\n", name, count / lookupSeconds, mapSeconds, sum);
+}
+
+void benchmarkStorage(std::size_t count)
+{
+    std::cout << fmt::format("\n-- heap vs huge-page bucket storage, {} elements --\n", count);
+    benchmarkRandomAccess<usu::vector<int, 1024, 1024, usu::tree_index<>>>("heap_storage", count);
+    benchmarkRandomAccess<usu::vector<int, 1024, 1024, usu::tree_index<>, usu::huge_page_storage<>>>("huge_page_storage", count);
+    benchmarkRandomAccess<usu::vector<int, 1024, 1024, usu::tree_index<>, usu::huge_page_storage<(std::size_t(32) << 20), true>>>("huge_page_storage (local node)", count);
+}
+
+// Full traversals of a vector whose buckets are scattered across the heap, so every bucket boundary is a cache miss without prefetching
+template <typename Vector>
+void benchmarkTraversal(const std::string& name, std::size_t count)
+{
+    // fill many vectors round-robin so consecutive buckets of each one are allocated far apart, then chain them together pairwise
+    std::vector<Vector> parts(1024);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        parts[i % parts.size()].add(static_cast<int>(i));
+    }
+    for (std::size_t step = 1; step < parts.size(); step *= 2)
+    {
+        for (std::size_t i = 0; i + step < parts.size(); i += 2 * step)
+        {
+            parts[i].append(std::move(parts[i + step]));
+        }
+    }
+    Vector& v = parts[0];
+
+    for (std::size_t distance : { 0, 1, 2, 4, 8 })
+    {
+        v.set_prefetch_distance(distance);
+        long long sum = 0;
+        double mapSeconds = timeSeconds([&]() { v.map([&sum](int& value) { sum += value; }); });
+        double iterateSeconds = timeSeconds(
+            [&]()
+            {
+                for (auto value : v)
+                {
+                    sum += value;
+                }
+            });
+        double accumulateSeconds = timeSeconds([&]() { sum += usu::accumulate(v, 0ll); });
+
+        std::cout << fmt::format("{:<12} distance {:<2}   map: {:>7.3f} s   iterate: {:>7.3f} s   accumulate: {:>7.3f} s   (checksum {})\n",
+                                 name, distance, mapSeconds, iterateSeconds, accumulateSeconds, sum);
+    }
+}
+
+void benchmarkPrefetch(std::size_t count)
+{
+    std::cout << fmt::format("\n-- traversal with next-bucket prefetching, {} elements --\n", count);
+    benchmarkTraversal<usu::vector<int, 16>>("flat_index", count);
+    benchmarkTraversal<usu::vector<int, 16, 16, usu::tree_index<>>>("tree_index", count);
+}
+
+// Building a large table: appending element by element versus laying out the buckets and filling them on one or all cores
+void benchmarkFill(std::size_t count)
+{
+    using Vector = usu::vector<std::uint64_t, 1024>;
+    std::cout << fmt::format("\n-- bulk construction, {} elements, {} hardware threads --\n", count, std::thread::hardware_concurrency());
+    auto value = [](std::size_t index) { return static_cast<std::uint64_t>(index) * 2654435761u; };
+
+    double addSeconds = timeSeconds(
+        [&]()
+        {
+            Vector v;
+            for (std::size_t i = 0; i < count; i++)
+            {
+                v.add(value(i));
+            }
+        });
+    double serialSeconds = timeSeconds(
+        [&]()
+        {
+            Vector v;
+            v.generate(count, value, 1);
+        });
+    double parallelSeconds = timeSeconds(
+        [&]()
+        {
+            Vector v;
+            v.generate(count, value);
+        });
+
+    std::cout << fmt::format("add loop: {:>7.3f} s   generate (1 thread): {:>7.3f} s   generate (all cores): {:>7.3f} s\n", addSeconds, serialSeconds, parallelSeconds);
+}
+
+// Per-operation latency on a fragmented vector, repaired either by periodic full compact() calls or by a small budget on every operation
+void benchmarkCompactionMode(const std::string& name, std::size_t count, std::size_t budget, std::size_t compactEvery)
+{
+    usu::vector<int, 64, 64, usu::tree_index<>> v;
+    std::mt19937 engine(5);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        v.insert(std::uniform_int_distribution<std::size_t>(0, v.size())(engine), static_cast<int>(i));
+    }
+    for (std::size_t i = 0; i < count / 2; i++)
+    {
+        v.remove(std::uniform_int_distribution<std::size_t>(0, v.size() - 1)(engine));
+    }
+    v.set_compaction(budget);
+
+    std::vector<std::uint64_t> latencies;
+    latencies.reserve(count);
+    long long checksum = 0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        switch (i % 3)
+        {
+            case 0:
+                v.insert(std::uniform_int_distribution<std::size_t>(0, v.size())(engine), static_cast<int>(i));
+                break;
+            case 1:
+                v.remove(std::uniform_int_distribution<std::size_t>(0, v.size() - 1)(engine));
+                break;
+            default:
+                checksum += v[std::uniform_int_distribution<std::size_t>(0, v.size() - 1)(engine)];
+                break;
+        }
+        if (compactEvery > 0 && i % compactEvery == compactEvery - 1)
+        {
+            v.compact();
+        }
+        latencies.push_back(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) { return latencies[static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1))]; };
+    double fill = static_cast<double>(v.size()) / static_cast<double>(v.capacity());
+    std::cout << fmt::format("{:<28} p50: {:>6} ns   p99: {:>6} ns   p99.9: {:>7} ns   max: {:>9} ns   fill: {:>5.1f}%   (checksum {})\n",
+                             name, percentile(0.5), percentile(0.99), percentile(0.999), latencies.back(), fill * 100, checksum);
+}
+
+void benchmarkCompaction(std::size_t count)
+{
+    std::cout << fmt::format("\n-- operation latency on a fragmented vector, {} operations --\n", count);
+    benchmarkCompactionMode("no compaction", count, 0, 0);
+    benchmarkCompactionMode("compact() every 10000 ops", count, 0, 10000);
+    benchmarkCompactionMode("incremental, budget 8", count, 8, 0);
+    benchmarkCompactionMode("incremental, budget 32", count, 32, 0);
+}
+
+// Single-field scans over a 32-byte particle, stored element by element in usu::vector and field by field in usu::columnar_vector
+void benchmarkColumnar(std::size_t count)
+{
+    using Particle = std::tuple<float, float, float, float, float, float, float, std::int32_t>; // position, velocity, mass, id
+    constexpr std::size_t Mass = 6;
+    constexpr std::size_t Id = 7;
+    std::cout << fmt::format("\n-- single-field scans, {} elements of {} bytes --\n", count, sizeof(Particle));
+
+    usu::vector<Particle, 1024, 1024, usu::tree_index<>> rows;
+    usu::columnar_vector<Particle, 1024, usu::tree_index<>> columns;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto f = static_cast<float>(i % 1000);
+        Particle particle{ f, f, f, 0.0f, 0.0f, 0.0f, f * 0.5f, static_cast<std::int32_t>(i) };
+        rows.add(particle);
+        columns.add(particle);
+    }
+    std::mt19937 engine(13);
+    std::uniform_int_distribution<std::size_t> position(0, count - 1);
+
+    for (int layout = 0; layout < 2; layout++)
+    {
+        double sum = 0;
+        std::size_t matches = 0;
+        double sumSeconds = 0;
+        double countSeconds = 0;
+        double mapSeconds = 0;
+        double lookupSeconds = 0;
+        if (layout == 0)
+        {
+            sumSeconds = timeSeconds([&]() { sum += usu::accumulate(rows, 0.0, [](double total, const Particle& p) { return total + std::get<Mass>(p); }); });
+            countSeconds = timeSeconds([&]() { matches += usu::count_if(rows, [](const Particle& p) { return std::get<Id>(p) % 3 == 0; }); });
+            mapSeconds = timeSeconds([&]() { rows.map([](Particle& p) { std::get<Mass>(p) *= 1.0001f; }); });
+            lookupSeconds = timeSeconds(
+                [&]()
+                {
+                    for (std::size_t i = 0; i < count / 10; i++)
+                    {
+                        sum += std::get<0>(rows[position(engine)]);
+                    }
+                });
+        }
+        else
+        {
+            sumSeconds = timeSeconds([&]() { sum += usu::accumulate(columns.column<Mass>(), 0.0); });
+            countSeconds = timeSeconds([&]() { matches += usu::count_if(columns.column<Id>(), [](std::int32_t id) { return id % 3 == 0; }); });
+            mapSeconds = timeSeconds([&]() { columns.map<Mass>([](float& mass) { mass *= 1.0001f; }); });
+            lookupSeconds = timeSeconds(
+                [&]()
+                {
+                    for (std::size_t i = 0; i < count / 10; i++)
+                    {
+                        sum += std::get<0>(columns[position(engine)]);
+                    }
+                });
+        }
+
+        std::cout << fmt::format("{:<20} sum field: {:>7.3f} s   count_if field: {:>7.3f} s   map field: {:>7.3f} s   whole-element lookups: {:>7.3f} s   (checksum {:.0f} {})\n",
+                                 layout == 0 ? "usu::vector" : "usu::columnar_vector", sumSeconds, countSeconds, mapSeconds, lookupSeconds, sum, matches);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // Usage: Benchmark [section] [element count]
+    std::string section = argc > 1 ? argv[1] : "all";
+    std::size_t count = argc > 2 ? std::stoul(argv[2]) : 0;
+
+    if (section == "all" || section == "shifts")
+    {
+        benchmarkShifts(count > 0 ? count : 200000);
+    }
+    if (section == "all" || section == "tree")
+    {
+        benchmarkTree(count > 0 ? count : 200000);
+    }
+    if (section == "all" || section == "storage")
+    {
+        benchmarkStorage(count > 0 ? count : 20000000);
+    }
+    if (section == "all" || section == "prefetch")
+    {
+        benchmarkPrefetch(count > 0 ? count : 32000000);
+    }
+    if (section == "all" || section == "fill")
+    {
+        benchmarkFill(count > 0 ? count : 50000000);
+    }
+    if (section == "all" || section == "compaction")
+    {
+        benchmarkCompaction(count > 0 ? count : 300000);
+    }
+    if (section == "all" || section == "columnar")
+    {
+        benchmarkColumnar(count > 0 ? count : 20000000);
+    }
+
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include "trace.hpp"
+#include "vector.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fmt/format.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Positional operations on the standard containers, spelled the way usu::vector spells them
+template <typename Container>
+struct StdAdapter
+{
+    Container container;
+
+    void add(int value) { container.push_back(value); }
+    void insert(std::size_t index, int value) { container.insert(container.begin() + static_cast<std::ptrdiff_t>(index), value); }
+    void remove(std::size_t index) { container.erase(container.begin() + static_cast<std::ptrdiff_t>(index)); }
+    int& operator[](std::size_t index) { return container[index]; }
+    void pop_front() { container.erase(container.begin()); }
+    void pop_back() { container.pop_back(); }
+    void reset(std::size_t size) { container.assign(size, 0); }
+};
+
+template <typename Vector>
+struct UsuAdapter
+{
+    Vector container;
+
+    void add(int value) { container.add(value); }
+    void insert(std::size_t index, int value) { container.insert(index, value); }
+    void remove(std::size_t index) { container.remove(index); }
+    int& operator[](std::size_t index) { return container[index]; }
+    void pop_front() { container.pop_front(); }
+    void pop_back() { container.pop_back(); }
+    void reset(std::size_t size) { container.fill(size, 0); }
+};
+
+const char* operationName(usu::trace_op op)
+{
+    switch (op)
+    {
+        case usu::trace_op::add:
+            return "add";
+        case usu::trace_op::insert:
+            return "insert";
+        case usu::trace_op::remove:
+            return "remove";
+        case usu::trace_op::access:
+            return "operator[]";
+        case usu::trace_op::pop_front:
+            return "pop_front";
+        case usu::trace_op::pop_back:
+            return "pop_back";
+        case usu::trace_op::reset:
+            return "reset";
+    }
+    return "?";
+}
+
+// Runs every operation of the trace in order, timing each one, and prints latency percentiles per operation type.
+// Reset records rebuild the container at the recorded size and are not timed, since they stand for operations the trace does not model.
+template <typename Adapter>
+void replay(const std::string& name, const std::vector<usu::trace_entry>& trace)
+{
+    constexpr std::size_t OperationCount = static_cast<std::size_t>(usu::trace_op::pop_back) + 1;
+    std::vector<std::uint64_t> latencies[OperationCount];
+    Adapter adapter;
+    long long checksum = 0;
+
+    auto total = std::chrono::steady_clock::now();
+    for (const auto& entry : trace)
+    {
+        if (entry.op == usu::trace_op::reset)
+        {
+            adapter.reset(entry.index);
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        switch (entry.op)
+        {
+            case usu::trace_op::add:
+                adapter.add(static_cast<int>(entry.index));
+                break;
+            case usu::trace_op::insert:
+                adapter.insert(entry.index, static_cast<int>(entry.index));
+                break;
+            case usu::trace_op::remove:
+                adapter.remove(entry.index);
+                break;
+            case usu::trace_op::access:
+                checksum += adapter[entry.index];
+                break;
+            case usu::trace_op::pop_front:
+                adapter.pop_front();
+                break;
+            case usu::trace_op::pop_back:
+                adapter.pop_back();
+                break;
+            case usu::trace_op::reset:
+                break;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        latencies[static_cast<std::size_t>(entry.op)].push_back(static_cast<std::uint64_t>(elapsed));
+    }
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - total;
+
+    std::cout << fmt::format("\n{}: {:.3f} s total (checksum {})\n", name, seconds.count(), checksum);
+    std::cout << fmt::format("  {:<12} {:>10} {:>8} {:>8} {:>8} {:>8} {:>10}\n", "op (ns)", "count", "p50", "p90", "p99", "p99.9", "max");
+    for (std::size_t op = 0; op < OperationCount; op++)
+    {
+        auto& samples = latencies[op];
+        if (samples.empty())
+        {
+            continue;
+        }
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&samples](double p) { return samples[static_cast<std::size_t>(p * static_cast<double>(samples.size() - 1))]; };
+        std::cout << fmt::format("  {:<12} {:>10} {:>8} {:>8} {:>8} {:>8} {:>10}\n", operationName(static_cast<usu::trace_op>(op)), samples.size(),
+                                 percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), samples.back());
+    }
+}
+
+// Records a synthetic trace by driving a traced usu::vector, so the tool can be tried without a production trace
+void recordSample(const std::string& path, std::size_t count)
+{
+    usu::trace_recorder recorder(path);
+    usu::vector<int> v;
+    v.set_trace(&recorder);
+    std::mt19937 engine(3);
+    std::uniform_int_distribution<int> choice(0, 99);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        int pick = choice(engine);
+        if (v.size() == 0 || pick < 25)
+        {
+            v.add(static_cast<int>(i));
+        }
+        else if (pick < 45)
+        {
+            v.insert(std::uniform_int_distribution<std::size_t>(0, v.size())(engine), static_cast<int>(i));
+        }
+        else if (pick < 60)
+        {
+            v.remove(std::uniform_int_distribution<std::size_t>(0, v.size() - 1)(engine));
+        }
+        else if (pick < 62)
+        {
+            v.pop_front();
+        }
+        else if (pick < 64)
+        {
+            v.pop_back();
+        }
+        else
+        {
+            v[std::uniform_int_distribution<std::size_t>(0, v.size() - 1)(engine)] += 1;
+        }
+    }
+    recorder.flush();
+    std::cout << fmt::format("recorded {} operations to {}\n", recorder.count(), path);
+}
+
+int main(int argc, char* argv[])
+{
+    // Usage: Replay <trace file>
+    //        Replay --sample <trace file> [operation count]
+    if (argc > 2 && std::string(argv[1]) == "--sample")
+    {
+        recordSample(argv[2], argc > 3 ? std::stoul(argv[3]) : 200000);
+        return 0;
+    }
+    if (argc != 2)
+    {
+        std::cout << "Usage: Replay <trace file>\n       Replay --sample <trace file> [operation count]\n";
+        return 1;
+    }
+
+    // read_trace checks every index against the size the traced vector had, so a bad trace stops here instead of mid-replay
+    std::vector<usu::trace_entry> trace;
+    try
+    {
+        trace = usu::read_trace(argv[1]);
+    }
+    catch (const std::exception& error)
+    {
+        std::cout << fmt::format("{}: {}\n", argv[1], error.what());
+        return 1;
+    }
+    std::cout << fmt::format("{} operations, recorded over {:.3f} s\n", trace.size(), trace.empty() ? 0.0 : trace.back().nanoseconds / 1e9);
+
+    replay<UsuAdapter<usu::vector<int, 10>>>("usu::vector<int, 10>", trace);
+    replay<UsuAdapter<usu::vector<int, 64>>>("usu::vector<int, 64>", trace);
+    replay<UsuAdapter<usu::vector<int, 512>>>("usu::vector<int, 512>", trace);
+    replay<UsuAdapter<usu::vector<int, 64, 64, usu::tree_index<>>>>("usu::vector<int, 64, tree_index>", trace);
+    replay<UsuAdapter<usu::vector<int, 512, 512, usu::tree_index<>>>>("usu::vector<int, 512, tree_index>", trace);
+    replay<StdAdapter<std::vector<int>>>("std::vector<int>", trace);
+    replay<StdAdapter<std::deque<int>>>("std::deque<int>", trace);
+
+    return 0;
+}
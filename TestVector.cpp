@@ -1,7 +1,23 @@
+#include "columnar_vector.hpp"
+#include "segmented.hpp"
 #include "vector.hpp"
 
+// writev and file descriptors are POSIX-only, so the scatter-gather tests are left out on Windows
+#if !defined(_WIN32)
+    #include "scatter_gather.hpp"
+
+    #include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <new>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <utility> // std::pair
 #include <vector>
 #include <iostream>
@@ -9,6 +25,37 @@
 // Set this to false to remove the debugging cout statements
 constexpr bool DEBUG_PRINT = true;
 
+// Counts every global allocation so tests can verify when the vector touches the heap
+std::atomic<std::size_t> allocationCount{ 0 };
+
+void* operator new(std::size_t size)
+{
+    allocationCount++;
+    if (void* memory = std::malloc(size == 0 ? 1 : size))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+// gcc inlines these replacements into std::allocator and then reports a false new/free mismatch
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic pop
+#endif
+
 int main(int argc, char* argv[])
 {
     testing::InitGoogleTest(&argc, argv);
@@ -474,4 +521,1479 @@ TEST(Constructor, SizeCapacity)
     // usu::vector<int> v3(100);
     // EXPECT_EQ(v3.size(), 100);
     // EXPECT_EQ(v3.capacity(), 200);
-}
\ No newline at end of file
+}
+
+TEST(Constructor, SizeThenAdd)
+{
+    usu::vector<int> v1(2);
+    v1.add(7);
+    EXPECT_EQ(v1.size(), 3);
+    EXPECT_EQ(v1[2], 7);
+
+    usu::vector<int> v2(25);
+    EXPECT_EQ(v2.size(), 25);
+    EXPECT_EQ(v2.capacity(), 30);
+    v2.add(7);
+    EXPECT_EQ(v2[25], 7);
+}
+
+TEST(Constructor, CopyAndMove)
+{
+    usu::vector<int> original;
+    for (int i = 0; i < 35; i++)
+    {
+        original.add(i);
+    }
+
+    usu::vector<int> copy(original);
+    copy[0] = 100;
+    EXPECT_EQ(original[0], 0);
+    EXPECT_EQ(copy.size(), original.size());
+    for (std::size_t pos = 1; pos < copy.size(); pos++)
+    {
+        EXPECT_EQ(copy[pos], original[pos]);
+    }
+
+    usu::vector<int> moved(std::move(copy));
+    EXPECT_EQ(moved.size(), 35);
+    EXPECT_EQ(moved[0], 100);
+    EXPECT_EQ(moved[34], 34);
+    moved.add(35);
+    EXPECT_EQ(moved[35], 35);
+
+    usu::vector<int> assigned{ 1, 2, 3 };
+    assigned = original;
+    EXPECT_EQ(assigned.size(), 35);
+    assigned = std::move(moved);
+    EXPECT_EQ(assigned.size(), 36);
+    EXPECT_EQ(assigned[35], 35);
+}
+
+TEST(InlineBucket, NoHeapAllocation)
+{
+    std::size_t before = allocationCount;
+    std::size_t size = 0;
+    int first = 0;
+    {
+        usu::vector<int> vec;
+        for (int i = 0; i < 9; i++)
+        {
+            vec.add(i);
+        }
+        vec.insert(3, 42);
+        vec.remove(3);
+        vec.remove(0);
+        size = vec.size();
+        first = vec[0];
+    }
+    EXPECT_EQ(allocationCount, before);
+    EXPECT_EQ(size, 8);
+    EXPECT_EQ(first, 1);
+
+    // the first split spills into a heap bucket
+    usu::vector<int> vec{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    before = allocationCount;
+    vec.add(10);
+    EXPECT_GT(allocationCount, before);
+    EXPECT_EQ(vec.capacity(), 20);
+}
+
+TEST(InlineBucket, CustomCapacity)
+{
+    usu::vector<int, 4, 2> vec;
+    EXPECT_EQ(vec.capacity(), 2);
+
+    std::vector<int> expected;
+    for (int i = 0; i < 20; i++)
+    {
+        vec.insert(vec.size() / 2, i);
+        expected.insert(expected.begin() + static_cast<long>(expected.size() / 2), i);
+    }
+    EXPECT_EQ(vec.size(), expected.size());
+
+    std::size_t pos = 0;
+    for (auto value : vec)
+    {
+        EXPECT_EQ(value, expected[pos++]);
+    }
+}
+
+TEST(Buckets, SplittingOddCapacity)
+{
+    usu::vector<int, 11> vec;
+    for (int i = 0; i < 11; i++)
+    {
+        vec.add(i);
+    }
+    vec.insert(2, 99);
+    EXPECT_EQ(vec.size(), 12);
+    EXPECT_EQ(vec[2], 99);
+    EXPECT_EQ(vec[11], 10);
+}
+
+TEST(FreeList, AddAfterClear)
+{
+    usu::vector<int> vec;
+    for (int i = 0; i < 50; i++)
+    {
+        vec.add(i);
+    }
+    vec.clear();
+    EXPECT_EQ(vec.size(), 0);
+    EXPECT_EQ(vec.capacity(), 10);
+
+    vec.add(7);
+    vec.insert(0, 3);
+    EXPECT_EQ(vec.size(), 2);
+    EXPECT_EQ(vec[0], 3);
+    EXPECT_EQ(vec[1], 7);
+}
+
+TEST(FreeList, ClearRecyclesBuckets)
+{
+    usu::vector<std::string> vec;
+    for (int round = 0; round < 3; round++)
+    {
+        std::size_t before = allocationCount;
+        for (int i = 0; i < 40; i++)
+        {
+            vec.add("x");
+        }
+        std::size_t allocations = allocationCount - before;
+        vec.clear();
+
+        // after the first round every split is served from the free list
+        if (round > 0)
+        {
+            EXPECT_EQ(allocations, 0);
+        }
+    }
+}
+
+TEST(FreeList, RemovedElementsAreReleased)
+{
+    auto shared = std::make_shared<int>(1);
+    usu::vector<std::shared_ptr<int>> vec;
+    for (int i = 0; i < 30; i++)
+    {
+        vec.add(shared);
+    }
+    EXPECT_EQ(shared.use_count(), 31);
+
+    // the emptied buckets sit on the free list, but none of their slots may still hold a copy
+    while (vec.size() > 0)
+    {
+        vec.remove(vec.size() / 2);
+    }
+    EXPECT_EQ(shared.use_count(), 1);
+
+    for (int i = 0; i < 30; i++)
+    {
+        vec.insert(vec.size() / 3, shared);
+    }
+    std::vector<std::size_t> indices(20, 0);
+    vec.remove_batch(indices);
+    EXPECT_EQ(shared.use_count(), 11);
+    vec.clear();
+    EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST(FreeList, RemoveRecyclesEmptyBuckets)
+{
+    usu::vector<int> vec;
+    for (int i = 0; i < 30; i++)
+    {
+        vec.add(i);
+    }
+    std::size_t fullCapacity = vec.capacity();
+    while (vec.size() > 5)
+    {
+        vec.remove(vec.size() - 1);
+    }
+    EXPECT_LT(vec.capacity(), fullCapacity);
+
+    std::size_t before = allocationCount;
+    for (int i = 5; i < 30; i++)
+    {
+        vec.add(i);
+    }
+    EXPECT_EQ(allocationCount, before);
+    for (int i = 0; i < 30; i++)
+    {
+        EXPECT_EQ(vec[i], i);
+    }
+}
+
+
+TEST(Splice, IntoMiddle)
+{
+    std::vector<int> expected;
+    usu::vector<int> v1;
+    usu::vector<int> v2;
+    for (int i = 0; i < 45; i++)
+    {
+        v1.add(i);
+        v2.add(1000 + i);
+        expected.push_back(i);
+    }
+    for (int i = 0; i < 45; i++)
+    {
+        expected.insert(expected.begin() + 17 + i, 1000 + i);
+    }
+
+    // only the boundary bucket and the other vector's inline elements get new buckets
+    std::size_t before = allocationCount;
+    v1.splice(17, v2);
+    EXPECT_LE(allocationCount - before, 4);
+
+    EXPECT_EQ(v2.size(), 0);
+    EXPECT_EQ(v2.capacity(), 10);
+    EXPECT_EQ(v1.size(), expected.size());
+    for (std::size_t pos = 0; pos < expected.size(); pos++)
+    {
+        EXPECT_EQ(v1[pos], expected[pos]);
+    }
+
+    // both vectors keep working afterwards
+    v1.insert(17, -1);
+    EXPECT_EQ(v1[17], -1);
+    v2.add(5);
+    EXPECT_EQ(v2[0], 5);
+}
+
+TEST(Splice, FrontAndBack)
+{
+    usu::vector<int> v1{ 3, 4, 5 };
+    usu::vector<int> front{ 0, 1, 2 };
+    usu::vector<int> back{ 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17 };
+
+    v1.splice(0, front);
+    v1.append(std::move(back));
+    EXPECT_EQ(v1.size(), 18);
+    int expected = 0;
+    for (auto value : v1)
+    {
+        EXPECT_EQ(value, expected++);
+    }
+
+    usu::vector<int> empty;
+    v1.splice(5, empty);
+    EXPECT_EQ(v1.size(), 18);
+    ASSERT_THROW(v1.splice(19, empty), std::range_error);
+    ASSERT_THROW(v1.splice(0, v1), std::invalid_argument);
+}
+
+TEST(Splice, SplitAt)
+{
+    for (std::size_t at : { 0, 1, 10, 15, 20, 33, 50 })
+    {
+        usu::vector<int> vec;
+        for (int i = 0; i < 50; i++)
+        {
+            vec.add(i);
+        }
+        std::size_t totalCapacity = vec.capacity();
+
+        auto tail = vec.split_at(at);
+        EXPECT_EQ(vec.size(), at);
+        EXPECT_EQ(tail.size(), 50 - at);
+        EXPECT_LE(vec.capacity() + tail.capacity(), totalCapacity + 20);
+        for (std::size_t pos = 0; pos < vec.size(); pos++)
+        {
+            EXPECT_EQ(vec[pos], static_cast<int>(pos));
+        }
+        for (std::size_t pos = 0; pos < tail.size(); pos++)
+        {
+            EXPECT_EQ(tail[pos], static_cast<int>(at + pos));
+        }
+
+        // putting the halves back together restores the original
+        vec.append(std::move(tail));
+        EXPECT_EQ(vec.size(), 50);
+        for (std::size_t pos = 0; pos < vec.size(); pos++)
+        {
+            EXPECT_EQ(vec[pos], static_cast<int>(pos));
+        }
+    }
+}
+
+
+// Applies the same random inserts and removes to a usu::vector and a std::vector and compares them
+template <typename T, typename Vector, typename MakeValue>
+void compareWithStdVector(Vector& vec, MakeValue makeValue, int operations)
+{
+    std::vector<T> expected;
+    unsigned int seed = 7;
+    auto next = [&seed]() { seed = seed * 1103515245 + 12345; return (seed >> 8) % 100000; };
+
+    for (int i = 0; i < operations; i++)
+    {
+        if (expected.empty() || next() % 3 != 0)
+        {
+            std::size_t pos = next() % (expected.size() + 1);
+            T value = makeValue(i);
+            vec.insert(pos, value);
+            expected.insert(expected.begin() + static_cast<long>(pos), value);
+        }
+        else
+        {
+            std::size_t pos = next() % expected.size();
+            vec.remove(pos);
+            expected.erase(expected.begin() + static_cast<long>(pos));
+        }
+    }
+
+    ASSERT_EQ(vec.size(), expected.size());
+    for (std::size_t pos = 0; pos < expected.size(); pos++)
+    {
+        EXPECT_EQ(vec[pos], expected[pos]);
+    }
+}
+
+struct Pod
+{
+    int a;
+    double b;
+    bool operator==(const Pod& other) const { return a == other.a && b == other.b; }
+};
+
+TEST(Modify, TrivialAndNonTrivialShifts)
+{
+    usu::vector<int, 7> ints;
+    compareWithStdVector<int>(ints, [](int i) { return i; }, 2000);
+
+    usu::vector<Pod, 16, 4> pods;
+    compareWithStdVector<Pod>(pods, [](int i) { return Pod{ i, i * 0.5 }; }, 2000);
+
+    usu::vector<std::string, 5> strings;
+    compareWithStdVector<std::string>(strings, [](int i) { return std::to_string(i); }, 2000);
+}
+
+
+TEST(Deque, PushAndPop)
+{
+    usu::vector<int, 8> vec;
+    std::vector<int> expected;
+    for (int i = 0; i < 50; i++)
+    {
+        vec.push_front(i);
+        expected.insert(expected.begin(), i);
+        vec.add(-i);
+        expected.push_back(-i);
+    }
+    for (int i = 0; i < 30; i++)
+    {
+        vec.pop_front();
+        expected.erase(expected.begin());
+        vec.pop_back();
+        expected.pop_back();
+    }
+    vec.push_front(99);
+    expected.insert(expected.begin(), 99);
+
+    ASSERT_EQ(vec.size(), expected.size());
+    for (std::size_t pos = 0; pos < expected.size(); pos++)
+    {
+        EXPECT_EQ(vec[pos], expected[pos]);
+    }
+
+    while (vec.size() > 0)
+    {
+        vec.pop_back();
+    }
+    ASSERT_THROW(vec.pop_back(), std::range_error);
+    ASSERT_THROW(vec.pop_front(), std::range_error);
+    vec.push_front(1);
+    EXPECT_EQ(vec[0], 1);
+}
+
+TEST(Deque, PushFrontDoesNotShift)
+{
+    // every element is pushed into a free slot in front of the head until the bucket fills up
+    usu::vector<std::string, 16> vec;
+    for (int i = 0; i < 16; i++)
+    {
+        vec.push_front(std::to_string(i));
+    }
+    EXPECT_EQ(vec.capacity(), 16);
+    for (int i = 0; i < 16; i++)
+    {
+        EXPECT_EQ(vec[i], std::to_string(15 - i));
+    }
+    // the wrapped ring survives a split, copy and move
+    vec.push_front("x");
+    auto copy = vec;
+    auto moved = std::move(vec);
+    EXPECT_EQ(copy[0], "x");
+    EXPECT_EQ(moved[0], "x");
+    EXPECT_EQ(copy[16], "0");
+    EXPECT_EQ(moved[16], "0");
+}
+
+TEST(Deque, PoppedElementsAreReleased)
+{
+    auto shared = std::make_shared<int>(1);
+    usu::vector<std::shared_ptr<int>, 4> vec;
+    for (int i = 0; i < 6; i++)
+    {
+        vec.push_front(shared);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        vec.pop_back();
+    }
+    EXPECT_EQ(shared.use_count(), 4);
+    for (int i = 0; i < 3; i++)
+    {
+        vec.pop_front();
+    }
+    EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST(Deque, RandomWrappedOperations)
+{
+    usu::vector<int, 6, 3> small;
+    compareWithStdVector<int>(small, [](int i) { return i; }, 3000);
+
+    usu::vector<std::string, 9> strings;
+    compareWithStdVector<std::string>(strings, [](int i) { return std::to_string(i); }, 3000);
+}
+
+
+TEST(Batch, InsertMatchesSequential)
+{
+    for (int round = 0; round < 20; round++)
+    {
+        usu::vector<int, 6, 4> batched;
+        usu::vector<int, 6, 4> sequential;
+        int initial = round * 7;
+        for (int i = 0; i < initial; i++)
+        {
+            batched.add(i);
+            sequential.add(i);
+        }
+
+        std::vector<std::pair<std::size_t, int>> inserts;
+        unsigned int seed = 11 + round;
+        for (int i = 0; i < 50; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            std::size_t pos = (seed >> 8) % (initial + i + 1);
+            inserts.emplace_back(pos, 1000 + i);
+            sequential.insert(pos, 1000 + i);
+        }
+        batched.insert_batch(inserts);
+
+        ASSERT_EQ(batched.size(), sequential.size());
+        for (std::size_t pos = 0; pos < sequential.size(); pos++)
+        {
+            EXPECT_EQ(batched[pos], sequential[pos]);
+        }
+    }
+}
+
+TEST(Batch, RemoveMatchesSequential)
+{
+    for (int round = 0; round < 20; round++)
+    {
+        usu::vector<std::string, 5> batched;
+        usu::vector<std::string, 5> sequential;
+        for (int i = 0; i < 80; i++)
+        {
+            batched.add(std::to_string(i));
+            sequential.add(std::to_string(i));
+        }
+
+        std::vector<std::size_t> indices;
+        unsigned int seed = 3 + round;
+        for (int i = 0; i < round * 4; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            std::size_t pos = (seed >> 8) % (80 - i);
+            indices.push_back(pos);
+            sequential.remove(pos);
+        }
+        batched.remove_batch(indices);
+
+        ASSERT_EQ(batched.size(), sequential.size());
+        for (std::size_t pos = 0; pos < sequential.size(); pos++)
+        {
+            EXPECT_EQ(batched[pos], sequential[pos]);
+        }
+        batched.add("end");
+        EXPECT_EQ(batched[batched.size() - 1], "end");
+    }
+}
+
+TEST(Batch, InvalidIndexLeavesVectorUntouched)
+{
+    usu::vector<int> vec{ 1, 2, 3 };
+    ASSERT_THROW(vec.insert_batch({ { 0, 9 }, { 5, 9 } }), std::range_error);
+    ASSERT_THROW(vec.remove_batch({ 0, 2 }), std::range_error);
+    EXPECT_EQ(vec.size(), 3);
+    EXPECT_EQ(vec[0], 1);
+    EXPECT_EQ(vec[2], 3);
+
+    vec.insert_batch({});
+    vec.remove_batch({ 0, 0, 0 });
+    EXPECT_EQ(vec.size(), 0);
+    vec.insert_batch({ { 0, 5 }, { 0, 4 }, { 2, 6 } });
+    EXPECT_EQ(vec[0], 4);
+    EXPECT_EQ(vec[1], 5);
+    EXPECT_EQ(vec[2], 6);
+}
+
+
+using TreeVector = usu::vector<int, 8, 4, usu::tree_index<4>>;
+
+TEST(TreeIndex, RandomOperations)
+{
+    TreeVector ints;
+    compareWithStdVector<int>(ints, [](int i) { return i; }, 20000);
+
+    usu::vector<std::string, 6, 6, usu::tree_index<>> strings;
+    compareWithStdVector<std::string>(strings, [](int i) { return std::to_string(i); }, 5000);
+}
+
+TEST(TreeIndex, MergesSparseBuckets)
+{
+    TreeVector vec;
+    for (int i = 0; i < 4000; i++)
+    {
+        vec.insert(vec.size() / 2, i);
+    }
+    // thin out every other element, then most of the rest, and check the buckets stay reasonably full
+    for (std::size_t pos = 0; pos < vec.size(); pos++)
+    {
+        vec.remove(pos);
+    }
+    while (vec.size() > 500)
+    {
+        vec.remove(vec.size() / 3);
+    }
+    EXPECT_LE(vec.capacity(), vec.size() * 4 + 8);
+
+    while (vec.size() > 0)
+    {
+        vec.pop_front();
+    }
+    EXPECT_EQ(vec.capacity(), 4);
+    vec.add(1);
+    EXPECT_EQ(vec[0], 1);
+}
+
+TEST(TreeIndex, BulkOperations)
+{
+    TreeVector v1;
+    TreeVector v2;
+    std::vector<int> expected;
+    for (int i = 0; i < 300; i++)
+    {
+        v1.add(i);
+        v2.push_front(-i);
+        expected.push_back(i);
+    }
+    for (int i = 0; i < 300; i++)
+    {
+        expected.insert(expected.begin() + 100 + i, i - 299);
+    }
+    v1.splice(100, v2);
+
+    auto tail = v1.split_at(250);
+    TreeVector copy(tail);
+    TreeVector moved(std::move(tail));
+    v1.append(std::move(moved));
+    ASSERT_EQ(v1.size(), expected.size());
+    for (std::size_t pos = 0; pos < expected.size(); pos++)
+    {
+        EXPECT_EQ(v1[pos], expected[pos]);
+    }
+    EXPECT_EQ(copy.size(), 350);
+    EXPECT_EQ(copy[0], expected[250]);
+
+    v1.remove_batch({ 0, 0, 10, 500 });
+    v1.insert_batch({ { 0, 7 }, { 3, 8 } });
+    expected.erase(expected.begin());
+    expected.erase(expected.begin());
+    expected.erase(expected.begin() + 10);
+    expected.erase(expected.begin() + 500);
+    expected.insert(expected.begin(), 7);
+    expected.insert(expected.begin() + 3, 8);
+    for (std::size_t pos = 0; pos < expected.size(); pos++)
+    {
+        EXPECT_EQ(v1[pos], expected[pos]);
+    }
+
+    v1.clear();
+    compareWithStdVector<int>(v1, [](int i) { return i; }, 2000);
+}
+
+TEST(TreeIndex, MoveKeepsBothTreesValid)
+{
+    TreeVector source;
+    std::vector<int> expected;
+    for (int i = 0; i < 1000; i++)
+    {
+        source.insert(source.size() / 2, i);
+        expected.insert(expected.begin() + expected.size() / 2, i);
+    }
+
+    // several tree levels move across, and both vectors must keep indexing and growing correctly afterwards
+    TreeVector moved(std::move(source));
+    TreeVector assigned;
+    assigned.add(-1);
+    assigned = std::move(moved);
+    for (auto vec : { &source, &moved })
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            vec->insert(vec->size() / 2, i);
+        }
+        EXPECT_EQ(vec->size(), 100);
+        EXPECT_EQ((*vec)[0], 1);
+    }
+    for (int i = 0; i < 200; i++)
+    {
+        assigned.insert(static_cast<std::size_t>(i * 13) % assigned.size(), -i);
+        expected.insert(expected.begin() + static_cast<std::size_t>(i * 13) % expected.size(), -i);
+    }
+    ASSERT_EQ(assigned.size(), expected.size());
+    for (std::size_t pos = 0; pos < expected.size(); pos++)
+    {
+        EXPECT_EQ(assigned[pos], expected[pos]);
+    }
+}
+
+TEST(TreeIndex, NoHeapAllocationWhenSmall)
+{
+    std::size_t before = allocationCount;
+    {
+        usu::vector<int, 10, 10, usu::tree_index<>> vec;
+        for (int i = 0; i < 10; i++)
+        {
+            vec.add(i);
+        }
+    }
+    EXPECT_EQ(allocationCount, before);
+}
+
+
+TEST(Segments, CoverEveryElementInOrder)
+{
+    usu::vector<int, 8> vec;
+    for (int i = 0; i < 30; i++)
+    {
+        vec.push_front(i);
+    }
+    vec.remove(10);
+
+    std::vector<int> flattened;
+    std::size_t spans = 0;
+    for (auto segment : vec.segments())
+    {
+        EXPECT_GT(segment.size(), 0);
+        flattened.insert(flattened.end(), segment.begin(), segment.end());
+        spans++;
+    }
+    ASSERT_EQ(flattened.size(), vec.size());
+    for (std::size_t pos = 0; pos < vec.size(); pos++)
+    {
+        EXPECT_EQ(flattened[pos], vec[pos]);
+    }
+    EXPECT_GE(spans, 4);
+
+    // writes through the spans land in the vector
+    for (auto segment : vec.segments())
+    {
+        for (auto& value : segment)
+        {
+            value *= 2;
+        }
+    }
+    EXPECT_EQ(vec[0], 58);
+
+    const auto& constant = vec;
+    std::size_t total = 0;
+    for (std::span<const int> segment : constant.segments())
+    {
+        total += segment.size();
+    }
+    EXPECT_EQ(total, vec.size());
+
+    usu::vector<int> empty;
+    EXPECT_TRUE(empty.segments().begin() == empty.segments().end());
+}
+
+TEST(Segments, Algorithms)
+{
+    usu::vector<int, 6, 3, usu::tree_index<>> vec;
+    for (int i = 0; i < 100; i++)
+    {
+        vec.insert(vec.size() / 2, i);
+    }
+
+    std::vector<int> copied(vec.size());
+    usu::copy(vec, copied.begin());
+    for (std::size_t pos = 0; pos < vec.size(); pos++)
+    {
+        EXPECT_EQ(copied[pos], vec[pos]);
+    }
+
+    EXPECT_EQ(usu::find(vec, vec[37]), 37);
+    EXPECT_EQ(usu::find(vec, -1), vec.size());
+    EXPECT_EQ(usu::count_if(vec, [](int value) { return value % 2 == 0; }), 50);
+    EXPECT_EQ(usu::accumulate(vec, 0), 4950);
+    EXPECT_EQ(usu::accumulate(vec, std::string(), [](std::string text, int value) { return text + (value == 0 ? "z" : ""); }), "z");
+
+    usu::fill(vec, 3);
+    const auto& constant = vec;
+    EXPECT_EQ(usu::accumulate(constant, 0L), 300L);
+}
+
+#if !defined(_WIN32)
+TEST(ScatterGather, WriteToFile)
+{
+    usu::vector<Pod, 4, 2> vec;
+    std::vector<Pod> expected;
+    for (int i = 0; i < 10000; i++)
+    {
+        vec.insert(vec.size() / 3, Pod{ i, i * 0.25 });
+        expected.insert(expected.begin() + static_cast<long>(expected.size() / 3), Pod{ i, i * 0.25 });
+    }
+
+    // far more buckets than a single writev accepts, so the write is split into batches
+    EXPECT_GT(usu::iovecs(vec).size(), 1024);
+
+    char path[] = "/tmp/usu_vector_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(usu::write_to(vec, fd), vec.size() * sizeof(Pod));
+
+    std::vector<Pod> readBack(vec.size());
+    EXPECT_EQ(pread(fd, readBack.data(), readBack.size() * sizeof(Pod), 0), static_cast<ssize_t>(readBack.size() * sizeof(Pod)));
+    close(fd);
+    unlink(path);
+
+    for (std::size_t pos = 0; pos < expected.size(); pos++)
+    {
+        EXPECT_EQ(readBack[pos], expected[pos]);
+    }
+}
+
+TEST(ScatterGather, WriteToPipe)
+{
+    // more than a pipe buffer holds, so writev blocks and resumes while the reader drains it
+    usu::vector<int, 16> vec;
+    for (int i = 0; i < 100000; i++)
+    {
+        vec.push_front(i);
+    }
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::vector<int> readBack(vec.size());
+    std::thread reader([&]()
+        {
+            auto bytes = reinterpret_cast<char*>(readBack.data());
+            std::size_t total = readBack.size() * sizeof(int);
+            std::size_t received = 0;
+            while (received < total)
+            {
+                ssize_t count = read(fds[0], bytes + received, total - received);
+                if (count <= 0)
+                {
+                    break;
+                }
+                received += static_cast<std::size_t>(count);
+            }
+        });
+    const auto& constant = vec;
+    EXPECT_EQ(usu::write_to(constant, fds[1]), vec.size() * sizeof(int));
+    reader.join();
+    close(fds[0]);
+    close(fds[1]);
+
+    for (std::size_t pos = 0; pos < vec.size(); pos++)
+    {
+        EXPECT_EQ(readBack[pos], vec[pos]);
+    }
+
+    ASSERT_THROW(usu::write_to(vec, -1), std::system_error);
+
+    // a temporary view binds like it does for the segmented algorithms
+    usu::columnar_vector<std::tuple<int, double>, 8> rows{ { 1, 1.0 }, { 2, 2.0 } };
+    EXPECT_EQ(usu::iovecs(rows.column<0>()).size(), 1u);
+}
+#endif
+TEST(HugePageStorage, RandomOperations)
+{
+    usu::vector<int, 16, 4, usu::flat_index, usu::huge_page_storage<>> ints;
+    compareWithStdVector<int>(ints, [](int i) { return i; }, 3000);
+
+    // non-trivial elements are constructed and destroyed in place inside the region
+    usu::vector<std::string, 8, 8, usu::tree_index<4>, usu::huge_page_storage<(1 << 16), true>> strings;
+    compareWithStdVector<std::string>(strings, [](int i) { return std::to_string(i) + " is long enough to need the heap"; }, 3000);
+}
+
+TEST(HugePageStorage, BucketsOutliveTheirVector)
+{
+    using HugeVector = usu::vector<int, 64, 64, usu::flat_index, usu::huge_page_storage<>>;
+    HugeVector tail;
+    {
+        HugeVector vec;
+        for (int i = 0; i < 100000; i++)
+        {
+            vec.add(i);
+        }
+
+        // 100000 ints in 64-element buckets fit in a single region, so every heap bucket sits inside one 32 MiB span
+        std::uintptr_t lowest = UINTPTR_MAX;
+        std::uintptr_t highest = 0;
+        bool first = true;
+        for (auto segment : vec.segments())
+        {
+            if (!first)
+            {
+                lowest = std::min(lowest, reinterpret_cast<std::uintptr_t>(segment.data()));
+                highest = std::max(highest, reinterpret_cast<std::uintptr_t>(segment.data() + segment.size()));
+            }
+            first = false;
+        }
+        EXPECT_LT(highest - lowest, std::size_t(32) << 20);
+
+        tail = vec.split_at(50000);
+    }
+
+    // the moved-out buckets still point into the first vector's region, which must stay mapped
+    ASSERT_EQ(tail.size(), 50000);
+    for (std::size_t pos = 0; pos < tail.size(); pos++)
+    {
+        EXPECT_EQ(tail[pos], static_cast<int>(pos + 50000));
+    }
+    tail.insert(10, -1);
+    EXPECT_EQ(tail[10], -1);
+}
+
+TEST(HugePageStorage, SharedPoolAcrossThreads)
+{
+    // split_at leaves both vectors carving from one pool, yet each may be used on its own thread
+    using HugeVector = usu::vector<int, 64, 64, usu::flat_index, usu::huge_page_storage<>>;
+    HugeVector vec;
+    for (int i = 0; i < 100000; i++)
+    {
+        vec.add(i);
+    }
+    auto tail = std::make_unique<HugeVector>(vec.split_at(10));
+
+    std::thread releaser([&tail]() { tail.reset(); });
+    for (int i = 0; i < 100000; i++)
+    {
+        vec.add(i);
+    }
+    releaser.join();
+
+    ASSERT_EQ(vec.size(), 100010);
+    EXPECT_EQ(vec[9], 9);
+    EXPECT_EQ(vec[10], 0);
+    EXPECT_EQ(vec[100009], 99999);
+}
+
+TEST(Iterators, AcrossBuckets)
+{
+    // random inserts leave buckets of every fill level, and pop_front empties the inline bucket while heap buckets remain
+    usu::vector<int, 5, 3> vec;
+    std::vector<int> expected;
+    for (int i = 0; i < 200; i++)
+    {
+        std::size_t pos = (static_cast<std::size_t>(i) * 37) % (expected.size() + 1);
+        vec.insert(pos, i);
+        expected.insert(expected.begin() + static_cast<long>(pos), i);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        vec.pop_front();
+        expected.erase(expected.begin());
+    }
+
+    std::size_t pos = 0;
+    for (auto itr = vec.begin(); itr != vec.end(); ++itr, pos++)
+    {
+        EXPECT_EQ(*itr, expected[pos]);
+    }
+    EXPECT_EQ(pos, expected.size());
+
+    auto itr = vec.end();
+    for (pos = expected.size(); pos > 0; pos--)
+    {
+        --itr;
+        EXPECT_EQ(*itr, expected[pos - 1]);
+    }
+    EXPECT_EQ(itr, vec.begin());
+}
+
+TEST(Prefetch, DistanceDoesNotChangeResults)
+{
+    usu::vector<int, 4> vec;
+    for (int i = 0; i < 1000; i++)
+    {
+        vec.insert(vec.size() / 2, i);
+    }
+    EXPECT_EQ(vec.prefetch_distance(), 1);
+
+    for (std::size_t distance : { 0, 1, 3, 64, 10000 })
+    {
+        vec.set_prefetch_distance(distance);
+        long long mapped = 0;
+        vec.map([&mapped](int& value) { mapped += value; });
+        long long iterated = 0;
+        for (auto value : vec)
+        {
+            iterated += value;
+        }
+        EXPECT_EQ(mapped, 999 * 1000 / 2);
+        EXPECT_EQ(iterated, 999 * 1000 / 2);
+        EXPECT_EQ(usu::accumulate(vec, 0ll), 999 * 1000 / 2);
+    }
+
+    // tree_index finds the buckets ahead through its nodes instead of the chain
+    TreeVector tree;
+    for (int i = 0; i < 1000; i++)
+    {
+        tree.insert(tree.size() / 2, i);
+    }
+    for (std::size_t distance : { 1, 7, 100 })
+    {
+        tree.set_prefetch_distance(distance);
+        EXPECT_EQ(usu::accumulate(tree, 0ll), 999 * 1000 / 2);
+    }
+
+    // copies and moves keep the tuning
+    vec.set_prefetch_distance(5);
+    usu::vector<int, 4> copy = vec;
+    usu::vector<int, 4> moved = std::move(copy);
+    EXPECT_EQ(moved.prefetch_distance(), 5);
+}
+
+TEST(Trace, RecordAndReadBack)
+{
+    std::string path = (std::filesystem::temp_directory_path() / "usu_trace_test").string();
+
+    {
+        usu::trace_recorder recorder(path);
+        usu::vector<int, 4> vec;
+        vec.set_trace(&recorder);
+        for (int i = 0; i < 10; i++)
+        {
+            vec.add(i);
+        }
+        vec.insert(3, 100);
+        vec.remove(200000 % vec.size());
+        vec[7] += 1;
+        vec.pop_front();
+        vec.pop_back();
+        ASSERT_THROW(vec.remove(100), std::range_error);
+
+        // the copy does not log to the same recorder
+        auto copy = vec;
+        copy.add(1);
+        vec.set_trace(nullptr);
+        vec.add(1);
+        EXPECT_EQ(recorder.count(), 16);
+    }
+
+    // attaching records the starting size
+    auto trace = usu::read_trace(path);
+    ASSERT_EQ(trace.size(), 16);
+    EXPECT_EQ(trace[0].op, usu::trace_op::reset);
+    EXPECT_EQ(trace[0].index, 0);
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(trace[i + 1].op, usu::trace_op::add);
+        EXPECT_EQ(trace[i + 1].index, static_cast<std::uint64_t>(i));
+    }
+    EXPECT_EQ(trace[11].op, usu::trace_op::insert);
+    EXPECT_EQ(trace[11].index, 3);
+    EXPECT_EQ(trace[12].op, usu::trace_op::remove);
+    EXPECT_EQ(trace[12].index, 200000 % 11);
+    EXPECT_EQ(trace[13].op, usu::trace_op::access);
+    EXPECT_EQ(trace[13].index, 7);
+    EXPECT_EQ(trace[14].op, usu::trace_op::pop_front);
+    EXPECT_EQ(trace[15].op, usu::trace_op::pop_back);
+    EXPECT_EQ(trace[15].index, 8);
+    for (std::size_t i = 1; i < trace.size(); i++)
+    {
+        EXPECT_GE(trace[i].nanoseconds, trace[i - 1].nanoseconds);
+    }
+
+    // a file cut off in the middle of a record is rejected rather than silently shortened
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 1));
+    EXPECT_THROW(usu::read_trace(path), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(Trace, BulkOperationsRecordTheirSize)
+{
+    std::string path = (std::filesystem::temp_directory_path() / "usu_trace_bulk_test").string();
+    {
+        usu::trace_recorder recorder(path);
+        usu::vector<int, 8> vec;
+        vec.generate(1000, [](std::size_t i) { return static_cast<int>(i); });
+        vec.set_trace(&recorder);
+        vec[500] += 1;
+        vec.insert_batch({ { 0, 1 }, { 2, 2 } });
+        vec.remove_batch({ 5, 5, 5 });
+        auto tail = vec.split_at(600);
+        vec.append(std::move(tail));
+        vec.remove(998);
+        vec.clear();
+        vec.add(1);
+    }
+
+    auto trace = usu::read_trace(path);
+    std::vector<std::pair<usu::trace_op, std::uint64_t>> expected = {
+        { usu::trace_op::reset, 1000 }, { usu::trace_op::access, 500 }, { usu::trace_op::reset, 1002 }, { usu::trace_op::reset, 999 },
+        { usu::trace_op::reset, 600 }, { usu::trace_op::reset, 999 }, { usu::trace_op::remove, 998 }, { usu::trace_op::reset, 0 },
+        { usu::trace_op::add, 0 }
+    };
+    ASSERT_EQ(trace.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); i++)
+    {
+        EXPECT_EQ(trace[i].op, expected[i].first);
+        EXPECT_EQ(trace[i].index, expected[i].second);
+    }
+
+    // a position the traced vector could not have had is rejected when the trace is read, not when it is replayed
+    {
+        usu::trace_recorder recorder(path);
+        recorder.record(usu::trace_op::reset, 10);
+        recorder.record(usu::trace_op::remove, 9);
+        recorder.record(usu::trace_op::access, 9);
+    }
+    EXPECT_THROW(usu::read_trace(path), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(Memory, UsageBreakdown)
+{
+    usu::vector<int, 8, 4> vec;
+    auto empty = vec.memory_usage();
+    EXPECT_EQ(empty.elements, 0);
+    EXPECT_EQ(empty.unused_slots, 4 * sizeof(int));
+    EXPECT_EQ(empty.index, 0);
+    EXPECT_EQ(empty.free_buckets, 0);
+    EXPECT_EQ(empty.total(), sizeof(vec));
+
+    for (int i = 0; i < 100; i++)
+    {
+        vec.insert(vec.size() / 2, i);
+    }
+    auto full = vec.memory_usage();
+    EXPECT_EQ(full.elements, 100 * sizeof(int));
+    EXPECT_EQ(full.unused_slots, (vec.capacity() - vec.size()) * sizeof(int));
+    EXPECT_GT(full.bucket_metadata, empty.bucket_metadata);
+
+    // draining the vector parks buckets on the free list, which still holds memory
+    while (vec.size() > 10)
+    {
+        vec.pop_back();
+    }
+    auto drained = vec.memory_usage();
+    EXPECT_EQ(drained.elements, 10 * sizeof(int));
+    EXPECT_GT(drained.free_buckets, 0);
+    EXPECT_LT(drained.bucket_metadata, full.bucket_metadata);
+
+    // a tree index reports its nodes
+    TreeVector tree;
+    for (int i = 0; i < 1000; i++)
+    {
+        tree.add(i);
+    }
+    EXPECT_GT(tree.memory_usage().index, 0);
+    EXPECT_EQ(tree.memory_usage().storage_reserve, 0);
+
+    // huge-page regions are reserved up front, and whatever the buckets have not taken is reported as such
+    usu::vector<int, 64, 64, usu::flat_index, usu::huge_page_storage<>> huge;
+    EXPECT_EQ(huge.memory_usage().storage_reserve, 0);
+    for (int i = 0; i < 1000; i++)
+    {
+        huge.add(i);
+    }
+    auto usage = huge.memory_usage();
+    // no reserve at all means mmap was refused and the storage fell back to the heap
+    if (usage.storage_reserve > 0)
+    {
+        std::size_t heapBuckets = (huge.capacity() - 64) / 64;
+        EXPECT_EQ(usage.storage_reserve + heapBuckets * 64 * sizeof(int), std::size_t(32) << 20);
+        EXPECT_GT(usage.total(), std::size_t(32) << 20);
+    }
+}
+
+TEST(Memory, FillHistogram)
+{
+    usu::vector<int, 8, 4> vec;
+    EXPECT_EQ(vec.fill_histogram(), std::vector<std::size_t>(9, 0));
+
+    // appending splits every full bucket in half, so every heap bucket but the last holds four elements
+    for (int i = 0; i < 4 + 4 * 10 + 3; i++)
+    {
+        vec.add(i);
+    }
+    auto histogram = vec.fill_histogram();
+    ASSERT_EQ(histogram.size(), 9);
+    std::size_t buckets = 0;
+    std::size_t elements = 0;
+    for (std::size_t fill = 0; fill < histogram.size(); fill++)
+    {
+        buckets += histogram[fill];
+        elements += fill * histogram[fill];
+    }
+    // the inline bucket is not part of the histogram; it kept the first two elements when it split
+    EXPECT_EQ(elements, vec.size() - 2);
+    EXPECT_EQ(buckets * 8 + 4, vec.capacity());
+    EXPECT_EQ(histogram[0], 0);
+    EXPECT_EQ(histogram[4], buckets - 1);
+}
+
+TEST(Generate, MatchesSerialFill)
+{
+    for (std::size_t threads : { 0, 1, 3, 8 })
+    {
+        usu::vector<long long, 16, 4> vec;
+        vec.add(-1);
+        vec.generate(10000, [](std::size_t index) { return static_cast<long long>(index * index); }, threads);
+        ASSERT_EQ(vec.size(), 10000);
+        std::size_t pos = 0;
+        for (auto value : vec)
+        {
+            EXPECT_EQ(value, static_cast<long long>(pos * pos));
+            pos++;
+        }
+    }
+
+    // the layout still accepts inserts and removes anywhere
+    TreeVector tree;
+    tree.generate(5000, [](std::size_t index) { return static_cast<int>(index); }, 4);
+    tree.insert(2500, -1);
+    tree.remove(0);
+    EXPECT_EQ(tree[2499], -1);
+    EXPECT_EQ(tree[2500], 2500);
+    EXPECT_EQ(tree[4999], 4999);
+
+    usu::vector<std::string> strings(25, std::string("filled"));
+    EXPECT_EQ(strings.size(), 25);
+    EXPECT_EQ(strings[24], "filled");
+    strings.fill(3, "again", 2);
+    EXPECT_EQ(strings.size(), 3);
+    EXPECT_EQ(strings[0], "again");
+
+    usu::vector<int> empty;
+    empty.fill(0, 7);
+    EXPECT_EQ(empty.size(), 0);
+}
+
+TEST(Generate, RethrowsGeneratorErrors)
+{
+    usu::vector<int, 8> vec;
+    ASSERT_THROW(vec.generate(1000, [](std::size_t index) -> int
+                     {
+                         if (index == 777)
+                         {
+                             throw std::runtime_error("bad element");
+                         }
+                         return 0;
+                     },
+                     4),
+                 std::runtime_error);
+    EXPECT_EQ(vec.size(), 0);
+
+    // the reused buckets must not resurface the values they held before the failed generate
+    usu::vector<int, 8> reused;
+    for (int i = 0; i < 100; i++)
+    {
+        reused.add(12345);
+    }
+    reused.clear();
+    ASSERT_THROW(reused.generate(100, [](std::size_t index) -> int
+                     {
+                         if (index == 60)
+                         {
+                             throw std::runtime_error("bad element");
+                         }
+                         return 1;
+                     },
+                     1),
+                 std::runtime_error);
+    EXPECT_EQ(reused.size(), 0);
+    reused.add(1);
+    EXPECT_EQ(reused[0], 1);
+    EXPECT_EQ(reused.size(), 1);
+}
+
+// Every heap bucket but the last one is at least 'minimum' full
+template <typename Vector>
+bool bucketsAtLeast(const Vector& vec, std::size_t minimum)
+{
+    auto histogram = vec.fill_histogram();
+    std::size_t below = 0;
+    for (std::size_t fill = 0; fill < minimum; fill++)
+    {
+        below += histogram[fill];
+    }
+    return below <= 1;
+}
+
+TEST(Compaction, InterleavedOperations)
+{
+    usu::vector<int, 8, 4> ints;
+    ints.set_compaction(3);
+    compareWithStdVector<int>(ints, [](int i) { return i; }, 5000);
+
+    usu::vector<std::string, 6> strings;
+    strings.set_compaction(1, 0.5);
+    compareWithStdVector<std::string>(strings, [](int i) { return std::to_string(i); }, 3000);
+
+    TreeVector tree;
+    tree.set_compaction(16, 1.0);
+    compareWithStdVector<int>(tree, [](int i) { return i; }, 5000);
+
+    ASSERT_THROW(ints.set_compaction(1, 0.0), std::invalid_argument);
+    ASSERT_THROW(ints.set_compaction(1, 1.5), std::invalid_argument);
+}
+
+TEST(Compaction, ConvergesWithinBudget)
+{
+    // fragment the vector: fill it, then remove most elements from the middle of every bucket
+    usu::vector<int, 16> vec;
+    std::vector<int> expected;
+    for (int i = 0; i < 4000; i++)
+    {
+        vec.insert(vec.size() / 2, i);
+        expected.insert(expected.begin() + static_cast<long>(expected.size() / 2), i);
+    }
+    for (std::size_t pos = 1; pos < expected.size(); pos += 2)
+    {
+        vec.remove(pos);
+        expected.erase(expected.begin() + static_cast<long>(pos));
+    }
+    EXPECT_FALSE(bucketsAtLeast(vec, 12));
+    auto bucketsBefore = vec.capacity();
+
+    // each operation may move at most four elements, yet repeated push/pop pairs eventually repack everything
+    vec.set_compaction(4);
+    for (int i = 0; i < 2000 && !bucketsAtLeast(vec, 12); i++)
+    {
+        vec.add(-1);
+        vec.pop_back();
+    }
+    EXPECT_TRUE(bucketsAtLeast(vec, 12));
+    EXPECT_LT(vec.capacity(), bucketsBefore);
+
+    ASSERT_EQ(vec.size(), expected.size());
+    for (std::size_t pos = 0; pos < expected.size(); pos++)
+    {
+        EXPECT_EQ(vec[pos], expected[pos]);
+    }
+}
+
+TEST(Compaction, FullCompact)
+{
+    usu::vector<int, 8, 4> vec;
+    for (int i = 0; i < 1000; i++)
+    {
+        vec.insert(vec.size() / 3, i);
+    }
+    for (int i = 0; i < 600; i++)
+    {
+        vec.remove(static_cast<std::size_t>(i * 7) % vec.size());
+    }
+    std::vector<int> expected;
+    for (auto value : vec)
+    {
+        expected.push_back(value);
+    }
+
+    vec.compact();
+    // every bucket is full except possibly the last one
+    EXPECT_TRUE(bucketsAtLeast(vec, 8));
+    EXPECT_LT(vec.capacity() - vec.size(), 8);
+    std::size_t pos = 0;
+    for (auto value : vec)
+    {
+        EXPECT_EQ(value, expected[pos++]);
+    }
+    EXPECT_EQ(pos, expected.size());
+}
+
+// A user type that opts into structured bindings, which is all columnar_vector needs to split it into columns
+struct Sample
+{
+    int id = 0;
+    double weight = 0;
+};
+
+template <std::size_t I>
+auto& get(Sample& sample)
+{
+    if constexpr (I == 0)
+    {
+        return sample.id;
+    }
+    else
+    {
+        return sample.weight;
+    }
+}
+
+template <std::size_t I>
+auto&& get(Sample&& sample)
+{
+    return std::move(get<I>(sample));
+}
+
+template <>
+struct std::tuple_size<Sample> : std::integral_constant<std::size_t, 2>
+{
+};
+
+template <std::size_t I>
+struct std::tuple_element<I, Sample>
+{
+    using type = std::conditional_t<I == 0, int, double>;
+};
+
+template <typename Vector>
+void compareColumnarWithStdVector(Vector& vec, int operations)
+{
+    using Row = std::tuple<int, double, std::string>;
+    std::vector<Row> expected;
+    for (int i = 0; i < operations; i++)
+    {
+        Row row{ i, i * 0.5, std::to_string(i) };
+        switch (i % 5)
+        {
+            case 0:
+            case 1:
+                vec.insert(static_cast<std::size_t>(i * 7) % (vec.size() + 1), row);
+                expected.insert(expected.begin() + static_cast<std::size_t>(i * 7) % (expected.size() + 1), row);
+                break;
+            case 2:
+                vec.add(row);
+                expected.push_back(row);
+                break;
+            case 3:
+                vec.remove(static_cast<std::size_t>(i * 3) % vec.size());
+                expected.erase(expected.begin() + static_cast<std::size_t>(i * 3) % expected.size());
+                break;
+            default:
+                vec.set(static_cast<std::size_t>(i) % vec.size(), row);
+                expected[static_cast<std::size_t>(i) % expected.size()] = row;
+                break;
+        }
+    }
+
+    ASSERT_EQ(vec.size(), expected.size());
+    for (std::size_t pos = 0; pos < expected.size(); pos++)
+    {
+        EXPECT_EQ(vec[pos], expected[pos]);
+        EXPECT_EQ(vec.template field<2>(pos), std::get<2>(expected[pos]));
+    }
+}
+
+TEST(Columnar, RandomOperations)
+{
+    usu::columnar_vector<std::tuple<int, double, std::string>, 4> flat;
+    compareColumnarWithStdVector(flat, 3000);
+
+    usu::columnar_vector<std::tuple<int, double, std::string>, 4, usu::tree_index<4>> tree;
+    compareColumnarWithStdVector(tree, 3000);
+
+    auto copy = tree;
+    auto moved = std::move(tree);
+    EXPECT_EQ(tree.size(), 0);
+    ASSERT_EQ(copy.size(), moved.size());
+    for (std::size_t pos = 0; pos < copy.size(); pos++)
+    {
+        EXPECT_EQ(copy[pos], moved[pos]);
+    }
+
+    moved.clear();
+    EXPECT_EQ(moved.size(), 0);
+    EXPECT_EQ(moved.capacity(), 4);
+    ASSERT_THROW(moved[0], std::range_error);
+    ASSERT_THROW(moved.remove(0), std::range_error);
+    ASSERT_THROW(moved.insert(1, {}), std::range_error);
+}
+
+TEST(Columnar, FieldProjections)
+{
+    usu::columnar_vector<Sample, 8> samples;
+    for (int i = 0; i < 100; i++)
+    {
+        samples.insert(samples.size() / 2, { i, i * 0.25 });
+    }
+
+    EXPECT_EQ(usu::accumulate(samples.column<0>(), 0), 4950);
+    EXPECT_DOUBLE_EQ(usu::accumulate(samples.column<1>(), 0.0), 4950 * 0.25);
+    EXPECT_EQ(usu::count_if(samples.column<0>(), [](int id) { return id % 2 == 0; }), 50);
+    EXPECT_EQ(samples.column<0>()[usu::find(samples.column<0>(), 99)], 99);
+
+    // a per-field map only touches its own column
+    samples.map<1>([](double& weight) { weight *= 4; });
+    samples.field<0>(10) = -1;
+    for (std::size_t pos = 0; pos < samples.size(); pos++)
+    {
+        Sample sample = samples[pos];
+        if (pos == 10)
+        {
+            EXPECT_EQ(sample.id, -1);
+        }
+        else
+        {
+            EXPECT_DOUBLE_EQ(sample.weight, sample.id);
+        }
+    }
+
+    samples.map([](Sample& sample) { sample.id = static_cast<int>(sample.weight) + 1; });
+    const auto& view = samples;
+    for (std::size_t pos = 0; pos < view.size(); pos++)
+    {
+        EXPECT_EQ(view.field<0>(pos), static_cast<int>(view.column<1>()[pos]) + 1);
+    }
+    ASSERT_THROW(view.field<1>(view.size()), std::range_error);
+}
+
+TEST(Columnar, RemovedElementsAreReleased)
+{
+    auto shared = std::make_shared<int>(1);
+    usu::columnar_vector<std::tuple<std::shared_ptr<int>, int>, 4> rows;
+    for (int i = 0; i < 30; i++)
+    {
+        rows.add({ shared, i });
+    }
+    EXPECT_EQ(shared.use_count(), 31);
+
+    // the first bucket stays allocated, but none of its vacated fields may still hold a copy
+    while (rows.size() > 0)
+    {
+        rows.remove(rows.size() / 2);
+    }
+    EXPECT_EQ(shared.use_count(), 1);
+
+    // inserts in the middle split buckets, which moves fields out of the front half
+    for (int i = 0; i < 30; i++)
+    {
+        rows.insert(rows.size() / 3, { shared, i });
+    }
+    for (int i = 0; i < 20; i++)
+    {
+        rows.remove(0);
+    }
+    EXPECT_EQ(shared.use_count(), 11);
+    rows.clear();
+    EXPECT_EQ(shared.use_count(), 1);
+    rows.clear();
+    EXPECT_EQ(rows.size(), 0u);
+}
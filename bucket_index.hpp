@@ -0,0 +1,574 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef> // for std::size_t
+#include <utility>
+#include <vector>
+
+namespace usu
+{
+    //
+    // Index policies decide how usu::vector finds the bucket holding a position. Every bucket derives from the
+    // policy's hook, and the vector tells the index whenever buckets are linked, unlinked or change size.
+    //
+
+    // Walks the bucket chain from the first bucket: no bookkeeping at all, O(buckets) lookups
+    struct flat_index
+    {
+        struct hook
+        {
+        };
+
+        static constexpr bool merges_buckets = false;
+
+        template <typename Bucket>
+        class type
+        {
+            public:
+                using size_type = std::size_t;
+
+                // returns the bucket holding 'index' and leaves 'index' as the position inside that bucket
+                Bucket* find(Bucket* first, size_type& index) const
+                {
+                    auto bucket = first;
+                    while (bucket != nullptr && index >= bucket->getSize())
+                    {
+                        index -= bucket->getSize();
+                        bucket = bucket->getNext();
+                    }
+                    return bucket;
+                }
+
+                // like find, but a position right past the end of a bucket belongs to that bucket rather than the next one
+                Bucket* findInsert(Bucket* first, size_type& index) const
+                {
+                    auto bucket = first;
+                    while (bucket != nullptr && index > bucket->getSize())
+                    {
+                        index -= bucket->getSize();
+                        bucket = bucket->getNext();
+                    }
+                    return bucket;
+                }
+
+                void rebuild(Bucket*) {}
+                void update(Bucket*) {}
+                void insertAfter(Bucket*, Bucket*) {}
+                void erase(Bucket*) {}
+                void replace(Bucket*, Bucket*) {}
+                void swap(type&) {}
+
+                // bytes the index allocates on top of the buckets themselves
+                size_type memoryBytes() const { return 0; }
+
+                // the bucket 'distance' links after 'bucket', or nullptr past the end; traversals use it to prefetch
+                static const Bucket* ahead(const Bucket* bucket, size_type distance)
+                {
+                    for (; bucket != nullptr && distance > 0; distance--)
+                    {
+                        bucket = bucket->getNext();
+                    }
+                    return bucket;
+                }
+        };
+    };
+
+    // Keeps the buckets as the leaves of a counted B+-tree: every internal node stores how many elements live under
+    // each of its children, so finding, inserting and removing by position are O(log n)
+    template <std::size_t Fanout = 16>
+    struct tree_index
+    {
+        static_assert(Fanout >= 4, "tree nodes need room to split and merge");
+
+        struct node;
+
+        struct hook
+        {
+            node* parent = nullptr;
+        };
+
+        // sparse leaves are merged into a neighbour so the tree does not fill up with nearly empty buckets
+        static constexpr bool merges_buckets = true;
+
+        struct node
+        {
+            node* parent = nullptr;
+            bool leaves = false; // the children are buckets rather than nodes
+            std::size_t count = 0;
+            std::size_t counts[Fanout];
+            void* children[Fanout];
+        };
+
+        template <typename Bucket>
+        class type
+        {
+            public:
+                using size_type = std::size_t;
+
+                type() = default;
+                type(const type&) = delete;
+                type& operator=(const type&) = delete;
+                ~type() { destroy(m_root, m_height); }
+
+                Bucket* find(Bucket*, size_type& index) const { return descend(index, false); }
+                Bucket* findInsert(Bucket*, size_type& index) const { return descend(index, true); }
+
+                void rebuild(Bucket* first);
+                void update(Bucket* bucket);
+                void insertAfter(Bucket* position, Bucket* bucket);
+                void erase(Bucket* bucket);
+                void replace(Bucket* old, Bucket* replacement);
+                void swap(type& other);
+
+                size_type nodeCount() const { return countNodes(m_root, m_height); }
+                size_type memoryBytes() const { return nodeCount() * sizeof(node); }
+
+                // like flat_index::ahead, but jumps through the parent's child array instead of chasing one next pointer per bucket
+                static const Bucket* ahead(const Bucket* bucket, size_type distance);
+
+            private:
+                Bucket* descend(size_type& index, bool insert) const;
+                void place(node* parent, size_type at, void* child, size_type count);
+                node* split(node* full);
+                node* rebalance(node* shrunk);
+                void refreshUp(node* changed);
+
+                static size_type slotOf(const node* parent, const void* child);
+                static size_type total(const node* n);
+                static void setParent(node* parent, void* child);
+                static void removeChild(node* parent, size_type slot);
+                static void destroy(void* root, size_type height);
+                static size_type countNodes(void* root, size_type height);
+
+                void* m_root = nullptr;
+                size_type m_height = 0; // 0 means m_root is the only bucket and no nodes are allocated
+        };
+    };
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    Bucket* tree_index<Fanout>::type<Bucket>::descend(size_type& index, bool insert) const
+    {
+        void* current = m_root;
+        for (size_type level = m_height; level > 0; level--)
+        {
+            auto n = static_cast<node*>(current);
+            size_type slot = 0;
+            while (slot + 1 < n->count && (insert ? index > n->counts[slot] : index >= n->counts[slot]))
+            {
+                index -= n->counts[slot];
+                slot++;
+            }
+            current = n->children[slot];
+        }
+
+        auto bucket = static_cast<Bucket*>(current);
+        bool found = insert ? index <= bucket->getSize() : index < bucket->getSize();
+        return found ? bucket : nullptr;
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    void tree_index<Fanout>::type<Bucket>::rebuild(Bucket* first)
+    {
+        // build the tree bottom-up, spreading each level evenly so every node is at least half full
+        destroy(m_root, m_height);
+        if (first->getNext() == nullptr)
+        {
+            // a single bucket needs no nodes at all
+            first->parent = nullptr;
+            m_root = first;
+            m_height = 0;
+            return;
+        }
+
+        std::vector<void*> level;
+        std::vector<size_type> counts;
+        for (auto bucket = first; bucket != nullptr; bucket = bucket->getNext())
+        {
+            bucket->parent = nullptr;
+            level.push_back(bucket);
+            counts.push_back(bucket->getSize());
+        }
+
+        m_height = 0;
+        bool leaves = true;
+        while (level.size() > 1)
+        {
+            size_type nodes = (level.size() + Fanout - 1) / Fanout;
+            std::vector<void*> parents;
+            std::vector<size_type> parentCounts;
+            size_type next = 0;
+            for (size_type i = 0; i < nodes; i++)
+            {
+                auto n = new node();
+                n->leaves = leaves;
+                size_type take = (level.size() - next) / (nodes - i);
+                for (size_type j = 0; j < take; j++, next++)
+                {
+                    n->children[j] = level[next];
+                    n->counts[j] = counts[next];
+                    setParent(n, level[next]);
+                }
+                n->count = take;
+                parents.push_back(n);
+                parentCounts.push_back(total(n));
+            }
+            level = std::move(parents);
+            counts = std::move(parentCounts);
+            leaves = false;
+            m_height++;
+        }
+        m_root = level.front();
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    void tree_index<Fanout>::type<Bucket>::update(Bucket* bucket)
+    {
+        // push the change in the bucket's size up to the root; unsigned wrap-around handles shrinking
+        node* n = bucket->parent;
+        if (n == nullptr)
+        {
+            return;
+        }
+        size_type slot = slotOf(n, bucket);
+        size_type delta = bucket->getSize() - n->counts[slot];
+        n->counts[slot] = bucket->getSize();
+        while (n->parent != nullptr)
+        {
+            n->parent->counts[slotOf(n->parent, n)] += delta;
+            n = n->parent;
+        }
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    void tree_index<Fanout>::type<Bucket>::insertAfter(Bucket* position, Bucket* bucket)
+    {
+        if (m_height == 0)
+        {
+            // the first split of the only bucket creates the root
+            auto root = new node();
+            root->leaves = true;
+            root->count = 2;
+            root->children[0] = position;
+            root->counts[0] = position->getSize();
+            root->children[1] = bucket;
+            root->counts[1] = bucket->getSize();
+            position->parent = root;
+            bucket->parent = root;
+            m_root = root;
+            m_height = 1;
+            return;
+        }
+
+        node* n = position->parent;
+        n->counts[slotOf(n, position)] = position->getSize();
+        place(n, slotOf(n, position) + 1, bucket, bucket->getSize());
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    void tree_index<Fanout>::type<Bucket>::erase(Bucket* bucket)
+    {
+        node* n = bucket->parent;
+        removeChild(n, slotOf(n, bucket));
+        bucket->parent = nullptr;
+        refreshUp(rebalance(n));
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    void tree_index<Fanout>::type<Bucket>::replace(Bucket* old, Bucket* replacement)
+    {
+        node* n = old->parent;
+        if (n == nullptr)
+        {
+            m_root = replacement;
+        }
+        else
+        {
+            n->children[slotOf(n, old)] = replacement;
+        }
+        replacement->parent = n;
+        old->parent = nullptr;
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    void tree_index<Fanout>::type<Bucket>::swap(type& other)
+    {
+        std::swap(m_root, other.m_root);
+        std::swap(m_height, other.m_height);
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    void tree_index<Fanout>::type<Bucket>::place(node* parent, size_type at, void* child, size_type count)
+    {
+        // puts 'child' at position 'at', splitting 'parent' first if it is full, then refreshes the counts above it
+        if (parent->count == Fanout)
+        {
+            node* right = split(parent);
+            if (at > parent->count)
+            {
+                at -= parent->count;
+                parent = right;
+            }
+        }
+
+        for (size_type i = parent->count; i > at; i--)
+        {
+            parent->children[i] = parent->children[i - 1];
+            parent->counts[i] = parent->counts[i - 1];
+        }
+        parent->children[at] = child;
+        parent->counts[at] = count;
+        parent->count++;
+        setParent(parent, child);
+        refreshUp(parent);
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    typename tree_index<Fanout>::node* tree_index<Fanout>::type<Bucket>::split(node* full)
+    {
+        // moves the upper half of a full node into a new sibling and hooks the sibling into the parent
+        auto right = new node();
+        right->leaves = full->leaves;
+        size_type half = full->count / 2;
+        for (size_type i = half; i < full->count; i++)
+        {
+            right->children[i - half] = full->children[i];
+            right->counts[i - half] = full->counts[i];
+            setParent(right, full->children[i]);
+        }
+        right->count = full->count - half;
+        full->count = half;
+
+        if (full == m_root)
+        {
+            auto root = new node();
+            root->count = 2;
+            root->children[0] = full;
+            root->counts[0] = total(full);
+            root->children[1] = right;
+            root->counts[1] = total(right);
+            full->parent = root;
+            right->parent = root;
+            m_root = root;
+            m_height++;
+        }
+        else
+        {
+            node* parent = full->parent;
+            size_type slot = slotOf(parent, full);
+            parent->counts[slot] = total(full);
+            place(parent, slot + 1, right, total(right));
+        }
+        return right;
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    typename tree_index<Fanout>::node* tree_index<Fanout>::type<Bucket>::rebalance(node* shrunk)
+    {
+        // fixes underfull nodes after a child was removed; returns the node whose counts still need pushing to the root
+        node* n = shrunk;
+        while (n != m_root && n->count < Fanout / 2)
+        {
+            node* parent = n->parent;
+            size_type slot = slotOf(parent, n);
+            size_type leftSlot = slot > 0 ? slot - 1 : slot;
+            auto left = static_cast<node*>(parent->children[leftSlot]);
+            auto right = static_cast<node*>(parent->children[leftSlot + 1]);
+
+            if (left->count + right->count <= Fanout)
+            {
+                // merge the right node into the left one and keep going up, since the parent lost a child
+                for (size_type i = 0; i < right->count; i++)
+                {
+                    left->children[left->count + i] = right->children[i];
+                    left->counts[left->count + i] = right->counts[i];
+                    setParent(left, right->children[i]);
+                }
+                left->count += right->count;
+                right->count = 0;
+                parent->counts[leftSlot] = total(left);
+                removeChild(parent, leftSlot + 1);
+                delete right;
+                n = parent;
+            }
+            else
+            {
+                // borrow the neighbouring child from the fuller sibling
+                if (n == left)
+                {
+                    left->children[left->count] = right->children[0];
+                    left->counts[left->count] = right->counts[0];
+                    setParent(left, right->children[0]);
+                    left->count++;
+                    removeChild(right, 0);
+                }
+                else
+                {
+                    for (size_type i = right->count; i > 0; i--)
+                    {
+                        right->children[i] = right->children[i - 1];
+                        right->counts[i] = right->counts[i - 1];
+                    }
+                    right->children[0] = left->children[left->count - 1];
+                    right->counts[0] = left->counts[left->count - 1];
+                    setParent(right, right->children[0]);
+                    right->count++;
+                    left->count--;
+                }
+                parent->counts[leftSlot] = total(left);
+                parent->counts[leftSlot + 1] = total(right);
+                return parent;
+            }
+        }
+
+        // a root left with a single child is replaced by that child
+        while (n == m_root && m_height > 0 && n->count == 1)
+        {
+            void* child = n->children[0];
+            if (n->leaves)
+            {
+                static_cast<Bucket*>(child)->parent = nullptr;
+            }
+            else
+            {
+                static_cast<node*>(child)->parent = nullptr;
+            }
+            delete n;
+            m_root = child;
+            m_height--;
+            if (m_height == 0)
+            {
+                return nullptr;
+            }
+            n = static_cast<node*>(child);
+        }
+        return n;
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    void tree_index<Fanout>::type<Bucket>::refreshUp(node* changed)
+    {
+        for (node* n = changed; n != nullptr && n->parent != nullptr; n = n->parent)
+        {
+            n->parent->counts[slotOf(n->parent, n)] = total(n);
+        }
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    const Bucket* tree_index<Fanout>::type<Bucket>::ahead(const Bucket* bucket, size_type distance)
+    {
+        while (bucket != nullptr && distance > 0)
+        {
+            const node* n = bucket->parent;
+            size_type step = 0;
+            if (n != nullptr)
+            {
+                size_type slot = slotOf(n, bucket);
+                step = std::min(distance, n->count - 1 - slot);
+                bucket = static_cast<const Bucket*>(n->children[slot + step]);
+            }
+            // only the last bucket under a leaf node (or a bucket outside any tree) has to follow its next pointer
+            if (step == 0)
+            {
+                bucket = bucket->getNext();
+                step = 1;
+            }
+            distance -= step;
+        }
+        return bucket;
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    typename tree_index<Fanout>::template type<Bucket>::size_type tree_index<Fanout>::type<Bucket>::slotOf(const node* parent, const void* child)
+    {
+        size_type slot = 0;
+        while (parent->children[slot] != child)
+        {
+            slot++;
+        }
+        return slot;
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    typename tree_index<Fanout>::template type<Bucket>::size_type tree_index<Fanout>::type<Bucket>::total(const node* n)
+    {
+        size_type sum = 0;
+        for (size_type i = 0; i < n->count; i++)
+        {
+            sum += n->counts[i];
+        }
+        return sum;
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    void tree_index<Fanout>::type<Bucket>::setParent(node* parent, void* child)
+    {
+        if (parent->leaves)
+        {
+            static_cast<Bucket*>(child)->parent = parent;
+        }
+        else
+        {
+            static_cast<node*>(child)->parent = parent;
+        }
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    void tree_index<Fanout>::type<Bucket>::removeChild(node* parent, size_type slot)
+    {
+        for (size_type i = slot; i + 1 < parent->count; i++)
+        {
+            parent->children[i] = parent->children[i + 1];
+            parent->counts[i] = parent->counts[i + 1];
+        }
+        parent->count--;
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    void tree_index<Fanout>::type<Bucket>::destroy(void* root, size_type height)
+    {
+        if (height == 0)
+        {
+            return;
+        }
+        auto n = static_cast<node*>(root);
+        for (size_type i = 0; i < n->count; i++)
+        {
+            destroy(n->children[i], height - 1);
+        }
+        delete n;
+    }
+
+    template <std::size_t Fanout>
+    template <typename Bucket>
+    typename tree_index<Fanout>::template type<Bucket>::size_type tree_index<Fanout>::type<Bucket>::countNodes(void* root, size_type height)
+    {
+        if (height == 0)
+        {
+            return 0;
+        }
+        auto n = static_cast<node*>(root);
+        size_type nodes = 1;
+        for (size_type i = 0; i < n->count; i++)
+        {
+            nodes += countNodes(n->children[i], height - 1);
+        }
+        return nodes;
+    }
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace usu
+{
+    //
+    // Storage policies decide where the element arrays of heap buckets come from. type<T, Capacity>::allocate()
+    // returns a value-initialized array of Capacity elements; whatever has to happen when the bucket is finally
+    // released travels with the returned pointer's deleter, so buckets can move between vectors freely.
+    // reservedBytes() reports memory the policy holds that no bucket has been handed, for memory_usage().
+    //
+
+    // One ordinary heap allocation per bucket
+    struct heap_storage
+    {
+        template <typename T, std::size_t Capacity>
+        class type
+        {
+            public:
+                std::shared_ptr<T[]> allocate() { return std::make_shared<T[]>(Capacity); }
+                std::size_t reservedBytes() const { return 0; }
+
+                // approximate bookkeeping per allocation beyond the elements: make_shared puts a reference-count block in front of them
+                static constexpr std::size_t OverheadBytes = 2 * sizeof(void*);
+        };
+    };
+
+    // Carves buckets out of large mmap regions aligned to and advised for transparent huge pages, which cuts TLB misses
+    // on multi-GB vectors. With BindLocal, each region prefers the NUMA node of the thread that creates it; otherwise the
+    // kernel's first-touch placement applies. Anything the platform refuses (no THP, no mbind, no mmap) degrades to the
+    // next best thing down to plain heap buckets. Every vector owns its own regions, so this only pays off for big vectors.
+    template <std::size_t RegionBytes = (std::size_t(32) << 20), bool BindLocal = false>
+    struct huge_page_storage
+    {
+        static constexpr std::size_t HugePageBytes = std::size_t(2) << 20;
+
+        template <typename T, std::size_t Capacity>
+        class type
+        {
+            public:
+                std::shared_ptr<T[]> allocate();
+
+                // the number of mmap regions carved so far, zero when everything fell back to the heap
+                std::size_t regionCount() const;
+                // every mapped byte not inside a slot some bucket currently owns; vectors sharing a pool after split_at each report all of it
+                std::size_t reservedBytes() const;
+
+                // approximate bookkeeping per allocation beyond the elements: a separately allocated reference-count block holding the deleter
+                static constexpr std::size_t OverheadBytes = 5 * sizeof(void*);
+
+            private:
+                static constexpr std::size_t SlotBytes = (Capacity * sizeof(T) + alignof(T) - 1) / alignof(T) * alignof(T);
+                static constexpr std::size_t RegionSize = (std::max(RegionBytes, SlotBytes) + HugePageBytes - 1) / HugePageBytes * HugePageBytes;
+
+                // shared with every bucket handed out, so the regions are unmapped only after the last bucket is gone. Vectors
+                // split from one another share a pool while being independent, so buckets can come back on any thread
+                struct Pool
+                {
+                    ~Pool();
+                    bool addRegion();
+
+                    std::mutex mutex; // guards everything below
+                    std::vector<std::pair<void*, std::size_t>> regions; // mapping and its length
+                    std::vector<T*> freeSlots;
+                    bool unavailable = false;
+                };
+
+                std::shared_ptr<Pool> m_pool;
+        };
+    };
+
+    template <std::size_t RegionBytes, bool BindLocal>
+    template <typename T, std::size_t Capacity>
+    std::shared_ptr<T[]> huge_page_storage<RegionBytes, BindLocal>::type<T, Capacity>::allocate()
+    {
+        if (!m_pool)
+        {
+            m_pool = std::make_shared<Pool>();
+        }
+        T* slot = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_pool->mutex);
+            if (m_pool->freeSlots.empty() && (m_pool->unavailable || !m_pool->addRegion()))
+            {
+                return std::make_shared<T[]>(Capacity);
+            }
+            slot = m_pool->freeSlots.back();
+            m_pool->freeSlots.pop_back();
+        }
+
+        try
+        {
+            std::uninitialized_value_construct_n(slot, Capacity);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_pool->mutex);
+            m_pool->freeSlots.push_back(slot);
+            throw;
+        }
+        return std::shared_ptr<T[]>(slot, [pool = m_pool](T* data)
+            {
+                std::destroy_n(data, Capacity);
+                std::lock_guard<std::mutex> lock(pool->mutex);
+                pool->freeSlots.push_back(data);
+            });
+    }
+
+    template <std::size_t RegionBytes, bool BindLocal>
+    template <typename T, std::size_t Capacity>
+    std::size_t huge_page_storage<RegionBytes, BindLocal>::type<T, Capacity>::regionCount() const
+    {
+        if (!m_pool)
+        {
+            return 0;
+        }
+        std::lock_guard<std::mutex> lock(m_pool->mutex);
+        return m_pool->regions.size();
+    }
+
+    template <std::size_t RegionBytes, bool BindLocal>
+    template <typename T, std::size_t Capacity>
+    std::size_t huge_page_storage<RegionBytes, BindLocal>::type<T, Capacity>::reservedBytes() const
+    {
+        if (!m_pool)
+        {
+            return 0;
+        }
+        std::lock_guard<std::mutex> lock(m_pool->mutex);
+        std::size_t handedOut = m_pool->regions.size() * (RegionSize / SlotBytes) - m_pool->freeSlots.size();
+        return m_pool->regions.size() * RegionSize - handedOut * Capacity * sizeof(T);
+    }
+
+    template <std::size_t RegionBytes, bool BindLocal>
+    template <typename T, std::size_t Capacity>
+    huge_page_storage<RegionBytes, BindLocal>::type<T, Capacity>::Pool::~Pool()
+    {
+#if defined(__linux__)
+        for (auto [region, length] : regions)
+        {
+            ::munmap(region, length);
+        }
+#endif
+    }
+
+    template <std::size_t RegionBytes, bool BindLocal>
+    template <typename T, std::size_t Capacity>
+    bool huge_page_storage<RegionBytes, BindLocal>::type<T, Capacity>::Pool::addRegion()
+    {
+#if defined(__linux__)
+        // over-map by one huge page and trim both ends, so the region starts on a huge page boundary
+        std::size_t mappedBytes = RegionSize + HugePageBytes;
+        void* mapped = ::mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED)
+        {
+            unavailable = true;
+            return false;
+        }
+        auto address = reinterpret_cast<std::uintptr_t>(mapped);
+        auto aligned = (address + HugePageBytes - 1) / HugePageBytes * HugePageBytes;
+        if (aligned > address)
+        {
+            ::munmap(mapped, aligned - address);
+        }
+        if (aligned + RegionSize < address + mappedBytes)
+        {
+            ::munmap(reinterpret_cast<void*>(aligned + RegionSize), address + mappedBytes - aligned - RegionSize);
+        }
+        auto region = reinterpret_cast<char*>(aligned);
+
+        // both are advice: a kernel without THP or NUMA support refuses and the region still works with normal pages
+    #if defined(MADV_HUGEPAGE)
+        ::madvise(region, RegionSize, MADV_HUGEPAGE);
+    #endif
+    #if defined(SYS_mbind) && defined(SYS_getcpu)
+        if constexpr (BindLocal)
+        {
+            unsigned cpu = 0;
+            unsigned node = 0;
+            unsigned long nodeMask = 0;
+            if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 && node < sizeof(nodeMask) * 8)
+            {
+                // MPOL_PREFERRED from <linux/mempolicy.h>, spelled out so the kernel headers are not needed to build
+                constexpr int preferredPolicy = 1;
+                nodeMask = 1ul << node;
+                ::syscall(SYS_mbind, region, RegionSize, preferredPolicy, &nodeMask, sizeof(nodeMask) * 8 + 1, 0u);
+            }
+        }
+    #endif
+
+        regions.emplace_back(region, RegionSize);
+        // hand slots out from the start of the region, so consecutive buckets share pages
+        for (std::size_t offset = RegionSize / SlotBytes * SlotBytes; offset > 0; offset -= SlotBytes)
+        {
+            freeSlots.push_back(reinterpret_cast<T*>(region + offset - SlotBytes));
+        }
+        return true;
+#else
+        unavailable = true;
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,622 @@
+#pragma once
+
+#include "bucket_index.hpp"
+
+#include <algorithm>
+#include <cstddef> // for std::size_t
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace usu
+{
+    //
+    // A structure-of-arrays counterpart to usu::vector: every bucket keeps one contiguous array per field of T, so a scan
+    // that reads a single field streams through that field alone instead of pulling whole elements through the cache.
+    // Elements are taken apart on the way in and assembled on the way out, which makes whole-element access slower than
+    // usu::vector; it pays off when the hot loops work field by field through map<I> or the segmented algorithms on column<I>().
+    //
+
+    // std::tuple, std::pair, std::array, or a struct that opts into structured bindings through tuple_size, tuple_element
+    // and get, as long as it can be brace-initialized from its fields in order
+    template <typename T>
+    concept TupleLike = requires
+    {
+        std::tuple_size<T>::value;
+    };
+
+    namespace detail
+    {
+        template <typename T, typename Sequence = std::make_index_sequence<std::tuple_size_v<T>>>
+        struct columns_of;
+
+        template <typename T, std::size_t... I>
+        struct columns_of<T, std::index_sequence<I...>>
+        {
+            using type = std::tuple<std::unique_ptr<std::tuple_element_t<I, T>[]>...>;
+        };
+    }
+
+    // Index selects how buckets are found by position, exactly as for usu::vector
+    template <TupleLike T, std::size_t BucketCapacity = 64, typename Index = flat_index>
+    class columnar_vector
+    {
+        static_assert(BucketCapacity >= 2, "a bucket must be able to split into two halves");
+        class Bucket;
+
+        public:
+            using size_type = std::size_t;
+
+            static constexpr size_type FieldCount = std::tuple_size_v<T>;
+
+            template <std::size_t I>
+            using field_type = std::tuple_element_t<I, T>;
+
+            // One field of every element: positional access, plus segments() yielding one std::span per non-empty bucket,
+            // so every algorithm in segmented.hpp runs straight over the field's arrays
+            template <std::size_t I, typename Owner>
+            class column_view
+            {
+                using Element = std::conditional_t<std::is_const_v<Owner>, const field_type<I>, field_type<I>>;
+
+                public:
+                    class segment_range
+                    {
+                        public:
+                            class iterator
+                            {
+                                public:
+                                    using iterator_category = std::forward_iterator_tag;
+                                    using difference_type = std::ptrdiff_t;
+                                    using value_type = std::span<Element>;
+
+                                    iterator(const Bucket* bucket = nullptr) :
+                                        m_bucket(skipEmpty(bucket))
+                                    {
+                                    }
+
+                                    std::span<Element> operator*() const { return std::span<Element>(m_bucket->template column<I>(), m_bucket->getSize()); }
+
+                                    iterator& operator++()
+                                    {
+                                        m_bucket = skipEmpty(m_bucket->getNext());
+                                        return *this;
+                                    }
+
+                                    iterator operator++(int)
+                                    {
+                                        iterator temp = *this;
+                                        ++(*this);
+                                        return temp;
+                                    }
+
+                                    bool operator==(const iterator& other) const { return m_bucket == other.m_bucket; }
+                                    bool operator!=(const iterator& other) const { return m_bucket != other.m_bucket; }
+
+                                private:
+                                    static const Bucket* skipEmpty(const Bucket* bucket)
+                                    {
+                                        while (bucket != nullptr && bucket->getSize() == 0)
+                                        {
+                                            bucket = bucket->getNext();
+                                        }
+                                        return bucket;
+                                    }
+
+                                    const Bucket* m_bucket;
+                            };
+
+                            segment_range(const Bucket* first) :
+                                m_first(first)
+                            {
+                            }
+
+                            iterator begin() const { return iterator(m_first); }
+                            iterator end() const { return iterator(); }
+
+                        private:
+                            const Bucket* m_first;
+                    };
+
+                    explicit column_view(Owner& owner) :
+                        m_owner(&owner)
+                    {
+                    }
+
+                    Element& operator[](size_type index) const { return m_owner->template field<I>(index); }
+                    size_type size() const { return m_owner->size(); }
+                    segment_range segments() const { return segment_range(m_owner->m_firstBucket); }
+
+                private:
+                    Owner* m_owner;
+            };
+
+            columnar_vector();
+            columnar_vector(std::initializer_list<T> list);
+            columnar_vector(const columnar_vector& other);
+            columnar_vector(columnar_vector&& other);
+            ~columnar_vector();
+
+            columnar_vector& operator=(const columnar_vector& other);
+            columnar_vector& operator=(columnar_vector&& other);
+
+            // assembled from the columns, so it is returned by value; use field<I> or set to change an element
+            T operator[](size_type index) const;
+            void set(size_type index, T value);
+
+            template <std::size_t I>
+            field_type<I>& field(size_type index);
+            template <std::size_t I>
+            const field_type<I>& field(size_type index) const;
+
+            template <std::size_t I>
+            column_view<I, columnar_vector> column() { return column_view<I, columnar_vector>(*this); }
+            template <std::size_t I>
+            column_view<I, const columnar_vector> column() const { return column_view<I, const columnar_vector>(*this); }
+
+            void add(T value);
+            void insert(size_type index, T value);
+            void remove(size_type index);
+            void clear();
+
+            // gathers each element, calls 'func' on it and scatters it back
+            void map(std::function<void(T&)> func);
+            // calls 'func' on field I of every element in a tight loop over that field's arrays, leaving the other fields untouched
+            template <std::size_t I, typename Function>
+            void map(Function func);
+
+            size_type size() const { return m_size; }
+            size_type capacity() const { return m_capacity; }
+
+        private:
+            // Unlike usu::vector's ring buffers, a bucket keeps its elements at the start of each column, so a column's
+            // elements are always one contiguous run
+            class Bucket : public Index::hook
+            {
+                public:
+                    Bucket();
+
+                    template <std::size_t I>
+                    field_type<I>* column() const { return std::get<I>(m_columns).get(); }
+
+                    size_type getSize() const { return m_bucketSize; }
+                    void setSize(size_type newSize) { m_bucketSize = newSize; }
+                    Bucket* getNext() const { return m_nextBucket; }
+                    void setNext(Bucket* next) { m_nextBucket = next; }
+                    Bucket* getPrev() const { return m_prevBucket; }
+                    void setPrev(Bucket* prev) { m_prevBucket = prev; }
+
+                    T get(size_type index) const;
+                    void set(size_type index, T&& value);
+                    void insertAt(size_type index, T&& value);
+                    void removeAt(size_type index);
+                    // moves the elements from 'at' onward to the start of the empty bucket 'target'
+                    void moveOut(size_type at, Bucket* target);
+                    // resets [from, from + count) in every column so vacated fields release what they hold
+                    void clearSlots(size_type from, size_type count);
+
+                private:
+                    typename detail::columns_of<T>::type m_columns;
+                    size_type m_bucketSize;
+                    Bucket* m_nextBucket;
+                    Bucket* m_prevBucket;
+            };
+
+            // calls 'func' with std::integral_constant<std::size_t, I> for every field I
+            template <typename Function>
+            static void forEachField(Function&& func);
+
+            Bucket* findBucket(size_type& index) const { return m_index.find(m_firstBucket, index); }
+            Bucket* findInsertBucket(size_type& index) const { return m_index.findInsert(m_firstBucket, index); }
+            Bucket* splitBucket(Bucket* bucket, size_type at);
+            void linkAfter(Bucket* position, Bucket* bucket);
+            void unlink(Bucket* bucket);
+            void swap(columnar_vector& other);
+
+            Bucket* m_firstBucket;
+            Bucket* m_lastBucket;
+            size_type m_size;
+            size_type m_capacity;
+            typename Index::template type<Bucket> m_index;
+    };
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    columnar_vector<T, BucketCapacity, Index>::columnar_vector() :
+        m_firstBucket(new Bucket()),
+        m_lastBucket(m_firstBucket),
+        m_size(0),
+        m_capacity(BucketCapacity)
+    {
+        m_index.rebuild(m_firstBucket);
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    columnar_vector<T, BucketCapacity, Index>::columnar_vector(std::initializer_list<T> list) :
+        columnar_vector()
+    {
+        for (const auto& value : list)
+        {
+            add(value);
+        }
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    columnar_vector<T, BucketCapacity, Index>::columnar_vector(const columnar_vector& other) :
+        columnar_vector()
+    {
+        for (auto bucket = other.m_firstBucket; bucket != nullptr; bucket = bucket->getNext())
+        {
+            for (size_type i = 0; i < bucket->getSize(); i++)
+            {
+                add(bucket->get(i));
+            }
+        }
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    columnar_vector<T, BucketCapacity, Index>::columnar_vector(columnar_vector&& other) :
+        columnar_vector()
+    {
+        // 'other' is left with the empty bucket just created for this vector
+        swap(other);
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    columnar_vector<T, BucketCapacity, Index>::~columnar_vector()
+    {
+        auto bucket = m_firstBucket;
+        while (bucket != nullptr)
+        {
+            auto next = bucket->getNext();
+            delete bucket;
+            bucket = next;
+        }
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    columnar_vector<T, BucketCapacity, Index>& columnar_vector<T, BucketCapacity, Index>::operator=(const columnar_vector& other)
+    {
+        if (this != &other)
+        {
+            columnar_vector copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    columnar_vector<T, BucketCapacity, Index>& columnar_vector<T, BucketCapacity, Index>::operator=(columnar_vector&& other)
+    {
+        if (this != &other)
+        {
+            swap(other);
+            other.clear();
+        }
+        return *this;
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    T columnar_vector<T, BucketCapacity, Index>::operator[](size_type index) const
+    {
+        if (index >= m_size)
+        {
+            throw std::range_error("Index out of range");
+        }
+        auto bucket = findBucket(index);
+        return bucket->get(index);
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::set(size_type index, T value)
+    {
+        if (index >= m_size)
+        {
+            throw std::range_error("Index out of range");
+        }
+        auto bucket = findBucket(index);
+        bucket->set(index, std::move(value));
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    template <std::size_t I>
+    typename columnar_vector<T, BucketCapacity, Index>::template field_type<I>& columnar_vector<T, BucketCapacity, Index>::field(size_type index)
+    {
+        if (index >= m_size)
+        {
+            throw std::range_error("Index out of range");
+        }
+        auto bucket = findBucket(index);
+        return bucket->template column<I>()[index];
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    template <std::size_t I>
+    const typename columnar_vector<T, BucketCapacity, Index>::template field_type<I>& columnar_vector<T, BucketCapacity, Index>::field(size_type index) const
+    {
+        if (index >= m_size)
+        {
+            throw std::range_error("Index out of range");
+        }
+        auto bucket = findBucket(index);
+        return bucket->template column<I>()[index];
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::add(T value)
+    {
+        auto lastBucket = m_lastBucket;
+        if (lastBucket->getSize() == BucketCapacity)
+        {
+            // the new element goes into the second half of the split
+            lastBucket = splitBucket(lastBucket, lastBucket->getSize() / 2);
+        }
+        lastBucket->insertAt(lastBucket->getSize(), std::move(value));
+        m_index.update(lastBucket);
+        m_size++;
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::insert(size_type index, T value)
+    {
+        if (index > m_size)
+        {
+            throw std::range_error("Invalid insert index");
+        }
+
+        size_type offset = index;
+        auto bucket = findInsertBucket(offset);
+        if (bucket->getSize() == BucketCapacity)
+        {
+            size_type mid = bucket->getSize() / 2;
+            auto secondHalfBucket = splitBucket(bucket, mid);
+            if (offset >= mid)
+            {
+                bucket = secondHalfBucket;
+                offset -= mid;
+            }
+        }
+
+        bucket->insertAt(offset, std::move(value));
+        m_index.update(bucket);
+        m_size++;
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::remove(size_type index)
+    {
+        if (index >= m_size)
+        {
+            throw std::range_error("Index out of range");
+        }
+
+        auto bucket = findBucket(index);
+        bucket->removeAt(index);
+        m_size--;
+
+        // an emptied bucket is released, except the first one, which always stays so the index has a root
+        if (bucket->getSize() == 0 && bucket != m_firstBucket)
+        {
+            unlink(bucket);
+            delete bucket;
+            m_capacity -= BucketCapacity;
+        }
+        else
+        {
+            m_index.update(bucket);
+        }
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::clear()
+    {
+        auto bucket = m_firstBucket->getNext();
+        while (bucket != nullptr)
+        {
+            auto next = bucket->getNext();
+            delete bucket;
+            bucket = next;
+        }
+        m_firstBucket->clearSlots(0, m_firstBucket->getSize());
+        m_firstBucket->setSize(0);
+        m_firstBucket->setNext(nullptr);
+        m_lastBucket = m_firstBucket;
+        m_size = 0;
+        m_capacity = BucketCapacity;
+        m_index.rebuild(m_firstBucket);
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::map(std::function<void(T&)> func)
+    {
+        for (auto bucket = m_firstBucket; bucket != nullptr; bucket = bucket->getNext())
+        {
+            for (size_type i = 0; i < bucket->getSize(); i++)
+            {
+                T value = bucket->get(i);
+                func(value);
+                bucket->set(i, std::move(value));
+            }
+        }
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    template <std::size_t I, typename Function>
+    void columnar_vector<T, BucketCapacity, Index>::map(Function func)
+    {
+        for (auto bucket = m_firstBucket; bucket != nullptr; bucket = bucket->getNext())
+        {
+            auto data = bucket->template column<I>();
+            for (size_type i = 0; i < bucket->getSize(); i++)
+            {
+                func(data[i]);
+            }
+        }
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    template <typename Function>
+    void columnar_vector<T, BucketCapacity, Index>::forEachField(Function&& func)
+    {
+        [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            (func(std::integral_constant<std::size_t, I>()), ...);
+        }(std::make_index_sequence<FieldCount>());
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    typename columnar_vector<T, BucketCapacity, Index>::Bucket* columnar_vector<T, BucketCapacity, Index>::splitBucket(Bucket* bucket, size_type at)
+    {
+        auto secondHalfBucket = new Bucket();
+        bucket->moveOut(at, secondHalfBucket);
+        m_index.update(bucket);
+        linkAfter(bucket, secondHalfBucket);
+        m_capacity += BucketCapacity;
+        return secondHalfBucket;
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::linkAfter(Bucket* position, Bucket* bucket)
+    {
+        bucket->setPrev(position);
+        bucket->setNext(position->getNext());
+        if (position->getNext() != nullptr)
+        {
+            position->getNext()->setPrev(bucket);
+        }
+        else
+        {
+            m_lastBucket = bucket;
+        }
+        position->setNext(bucket);
+        m_index.insertAfter(position, bucket);
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::unlink(Bucket* bucket)
+    {
+        // the first bucket is never unlinked, so every bucket passed in here has a predecessor
+        m_index.erase(bucket);
+        bucket->getPrev()->setNext(bucket->getNext());
+        if (bucket->getNext() != nullptr)
+        {
+            bucket->getNext()->setPrev(bucket->getPrev());
+        }
+        else
+        {
+            m_lastBucket = bucket->getPrev();
+        }
+        bucket->setNext(nullptr);
+        bucket->setPrev(nullptr);
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::swap(columnar_vector& other)
+    {
+        // every bucket is on the heap, so exchanging the pointers and the index moves the whole chain
+        std::swap(m_firstBucket, other.m_firstBucket);
+        std::swap(m_lastBucket, other.m_lastBucket);
+        std::swap(m_size, other.m_size);
+        std::swap(m_capacity, other.m_capacity);
+        m_index.swap(other.m_index);
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    columnar_vector<T, BucketCapacity, Index>::Bucket::Bucket() :
+        m_bucketSize(0),
+        m_nextBucket(nullptr),
+        m_prevBucket(nullptr)
+    {
+        forEachField(
+            [this](auto field)
+            {
+                constexpr std::size_t I = decltype(field)::value;
+                std::get<I>(m_columns) = std::make_unique<field_type<I>[]>(BucketCapacity);
+            });
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    T columnar_vector<T, BucketCapacity, Index>::Bucket::get(size_type index) const
+    {
+        return [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            return T{ std::get<I>(m_columns)[index]... };
+        }(std::make_index_sequence<FieldCount>());
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::Bucket::set(size_type index, T&& value)
+    {
+        forEachField(
+            [&](auto field)
+            {
+                constexpr std::size_t I = decltype(field)::value;
+                // std::get for the standard types, found by argument-dependent lookup for user types
+                using std::get;
+                std::get<I>(m_columns)[index] = get<I>(std::move(value));
+            });
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::Bucket::insertAt(size_type index, T&& value)
+    {
+        forEachField(
+            [&](auto field)
+            {
+                constexpr std::size_t I = decltype(field)::value;
+                auto data = std::get<I>(m_columns).get();
+                std::move_backward(data + index, data + m_bucketSize, data + m_bucketSize + 1);
+            });
+        set(index, std::move(value));
+        m_bucketSize++;
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::Bucket::removeAt(size_type index)
+    {
+        forEachField(
+            [&](auto field)
+            {
+                constexpr std::size_t I = decltype(field)::value;
+                auto data = std::get<I>(m_columns).get();
+                std::move(data + index + 1, data + m_bucketSize, data + index);
+            });
+        clearSlots(m_bucketSize - 1, 1);
+        m_bucketSize--;
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::Bucket::moveOut(size_type at, Bucket* target)
+    {
+        forEachField(
+            [&](auto field)
+            {
+                constexpr std::size_t I = decltype(field)::value;
+                auto data = std::get<I>(m_columns).get();
+                std::move(data + at, data + m_bucketSize, target->template column<I>());
+            });
+        target->setSize(m_bucketSize - at);
+        clearSlots(at, m_bucketSize - at);
+        m_bucketSize = at;
+    }
+
+    template <TupleLike T, std::size_t BucketCapacity, typename Index>
+    void columnar_vector<T, BucketCapacity, Index>::Bucket::clearSlots(size_type from, size_type count)
+    {
+        forEachField(
+            [&](auto field)
+            {
+                constexpr std::size_t I = decltype(field)::value;
+                if constexpr (!std::is_trivially_destructible_v<field_type<I>>)
+                {
+                    auto data = std::get<I>(m_columns).get();
+                    std::fill(data + from, data + from + count, field_type<I>());
+                }
+            });
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "segmented.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef> // for std::size_t
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace usu
+{
+    //
+    // Zero-copy output for vectors of trivially copyable elements: the iovec array points straight at the bucket
+    // storage, so the bytes go from the buckets to the file descriptor without being flattened into a buffer first.
+    //
+
+    template <Segmented Range>
+    std::vector<iovec> iovecs(Range&& range)
+    {
+        using Element = typename decltype(*range.segments().begin())::element_type;
+        static_assert(std::is_trivially_copyable_v<Element>, "only trivially copyable elements can be written as raw bytes");
+
+        std::vector<iovec> result;
+        for (auto segment : range.segments())
+        {
+            // iovec takes a non-const pointer even though writev never writes through it
+            result.push_back({ const_cast<std::remove_const_t<Element>*>(segment.data()), segment.size_bytes() });
+        }
+        return result;
+    }
+
+    // Writes every element to 'fd' with as few writev calls as possible, resuming after partial writes.
+    // Returns the number of bytes written; throws std::system_error if the descriptor reports an error.
+    template <Segmented Range>
+    std::size_t write_to(Range&& range, int fd)
+    {
+#ifdef IOV_MAX
+        constexpr std::size_t maxBatch = IOV_MAX;
+#else
+        constexpr std::size_t maxBatch = 1024;
+#endif
+        auto vectors = iovecs(range);
+        std::size_t written = 0;
+        std::size_t next = 0;
+        while (next < vectors.size())
+        {
+            int batch = static_cast<int>(std::min(maxBatch, vectors.size() - next));
+            ssize_t result = ::writev(fd, vectors.data() + next, batch);
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "writev failed");
+            }
+
+            // skip the buffers that went out completely and trim the one that went out partially
+            auto remaining = static_cast<std::size_t>(result);
+            written += remaining;
+            while (next < vectors.size() && remaining >= vectors[next].iov_len)
+            {
+                remaining -= vectors[next].iov_len;
+                next++;
+            }
+            if (remaining > 0)
+            {
+                vectors[next].iov_base = static_cast<char*>(vectors[next].iov_base) + remaining;
+                vectors[next].iov_len -= remaining;
+            }
+        }
+        return written;
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef> // for std::size_t
+#include <functional>
+
+namespace usu
+{
+    //
+    // Segmented versions of common algorithms. They run a tight loop over each contiguous span returned by
+    // segments() instead of stepping through the container's iterator one element at a time. Ranges are taken by
+    // forwarding reference, so views such as columnar_vector::column<I>() can be passed as temporaries.
+    //
+
+    template <typename T>
+    concept Segmented = requires(T& x)
+    {
+        x.segments();
+    };
+
+    template <Segmented Range, typename OutputIt>
+    OutputIt copy(Range&& range, OutputIt out)
+    {
+        for (auto segment : range.segments())
+        {
+            for (auto& value : segment)
+            {
+                *out++ = value;
+            }
+        }
+        return out;
+    }
+
+    template <Segmented Range, typename Value>
+    void fill(Range&& range, const Value& value)
+    {
+        for (auto segment : range.segments())
+        {
+            for (auto& element : segment)
+            {
+                element = value;
+            }
+        }
+    }
+
+    // returns the position of the first element equal to 'value', or the number of elements when there is none
+    template <Segmented Range, typename Value>
+    std::size_t find(Range&& range, const Value& value)
+    {
+        std::size_t position = 0;
+        for (auto segment : range.segments())
+        {
+            for (std::size_t i = 0; i < segment.size(); i++)
+            {
+                if (segment[i] == value)
+                {
+                    return position + i;
+                }
+            }
+            position += segment.size();
+        }
+        return position;
+    }
+
+    template <Segmented Range, typename Predicate>
+    std::size_t count_if(Range&& range, Predicate predicate)
+    {
+        std::size_t count = 0;
+        for (auto segment : range.segments())
+        {
+            for (auto& element : segment)
+            {
+                if (predicate(element))
+                {
+                    count++;
+                }
+            }
+        }
+        return count;
+    }
+
+    template <Segmented Range, typename Value, typename BinaryOp = std::plus<>>
+    Value accumulate(Range&& range, Value init, BinaryOp op = BinaryOp())
+    {
+        for (auto segment : range.segments())
+        {
+            for (auto& element : segment)
+            {
+                init = op(std::move(init), element);
+            }
+        }
+        return init;
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef> // for std::size_t
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace usu
+{
+    //
+    // Operation traces: a vector with a trace_recorder attached logs every positional operation, and read_trace loads
+    // the log back so the same mix can be replayed against other containers. The file starts with the "USUTRACE"
+    // magic and a version byte; each record is the operation byte followed by the index and the nanoseconds since the
+    // previous record, both as LEB128 varints, so a typical record takes four to six bytes. A reset record carries a
+    // size instead of an index: the vector held that many elements when the recorder was attached or after a bulk
+    // operation the trace does not model element by element.
+    //
+
+    enum class trace_op : std::uint8_t
+    {
+        add,
+        insert,
+        remove,
+        access,
+        pop_front,
+        pop_back,
+        reset
+    };
+
+    struct trace_entry
+    {
+        trace_op op;
+        std::uint64_t index;
+        std::uint64_t nanoseconds; // since the recorder was created
+    };
+
+    class trace_recorder
+    {
+        public:
+            // throws std::runtime_error if the file cannot be created
+            explicit trace_recorder(const std::string& path);
+
+            void record(trace_op op, std::uint64_t index);
+            void flush() { m_file.flush(); }
+            std::uint64_t count() const { return m_count; }
+
+        private:
+            void writeVarint(std::uint64_t value);
+
+            std::ofstream m_file;
+            std::chrono::steady_clock::time_point m_start;
+            std::uint64_t m_lastNanoseconds = 0;
+            std::uint64_t m_count = 0;
+    };
+
+    // throws std::runtime_error if the file is missing, is not a trace, ends in the middle of a record or names a position
+    // the traced vector could not have had, so every entry returned is safe to replay
+    std::vector<trace_entry> read_trace(const std::string& path);
+
+    inline constexpr char TraceMagic[8] = { 'U', 'S', 'U', 'T', 'R', 'A', 'C', 'E' };
+    inline constexpr std::uint8_t TraceVersion = 2; // version 1 had no reset records and always started from an empty vector
+
+    inline trace_recorder::trace_recorder(const std::string& path) :
+        m_file(path, std::ios::binary | std::ios::trunc),
+        m_start(std::chrono::steady_clock::now())
+    {
+        if (!m_file)
+        {
+            throw std::runtime_error("Cannot create trace file " + path);
+        }
+        m_file.write(TraceMagic, sizeof(TraceMagic));
+        m_file.put(static_cast<char>(TraceVersion));
+    }
+
+    inline void trace_recorder::record(trace_op op, std::uint64_t index)
+    {
+        auto now = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count());
+        m_file.put(static_cast<char>(op));
+        writeVarint(index);
+        writeVarint(now - m_lastNanoseconds);
+        m_lastNanoseconds = now;
+        m_count++;
+    }
+
+    inline void trace_recorder::writeVarint(std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            m_file.put(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        m_file.put(static_cast<char>(value));
+    }
+
+    inline std::vector<trace_entry> read_trace(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Cannot open trace file " + path);
+        }
+        char magic[sizeof(TraceMagic)] = {};
+        file.read(magic, sizeof(magic));
+        int version = file.get();
+        if (!file || !std::equal(magic, magic + sizeof(magic), TraceMagic) || version < 1 || version > TraceVersion)
+        {
+            throw std::runtime_error(path + " is not a usu::vector trace");
+        }
+
+        auto readVarint = [&file]()
+        {
+            std::uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                int byte = file.get();
+                if (byte == std::char_traits<char>::eof())
+                {
+                    throw std::runtime_error("Truncated trace record");
+                }
+                value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    return value;
+                }
+            }
+            throw std::runtime_error("Malformed trace record");
+        };
+
+        // follow the vector's size through the trace, so a record that does not fit it is reported here rather than during a replay
+        std::vector<trace_entry> entries;
+        std::uint64_t nanoseconds = 0;
+        std::uint64_t size = 0;
+        for (int op = file.get(); op != std::char_traits<char>::eof(); op = file.get())
+        {
+            if (op > static_cast<int>(version == 1 ? trace_op::pop_back : trace_op::reset))
+            {
+                throw std::runtime_error("Unknown trace operation");
+            }
+            std::uint64_t index = readVarint();
+            nanoseconds += readVarint();
+
+            auto kind = static_cast<trace_op>(op);
+            bool valid = kind == trace_op::reset || index < size || (index == size && (kind == trace_op::add || kind == trace_op::insert));
+            if (!valid)
+            {
+                throw std::runtime_error("Trace record " + std::to_string(entries.size()) + " is out of range for a vector of " + std::to_string(size) + " elements");
+            }
+            switch (kind)
+            {
+                case trace_op::add:
+                case trace_op::insert:
+                    size++;
+                    break;
+                case trace_op::remove:
+                case trace_op::pop_front:
+                case trace_op::pop_back:
+                    size--;
+                    break;
+                case trace_op::access:
+                    break;
+                case trace_op::reset:
+                    size = index;
+                    break;
+            }
+            entries.push_back({ kind, index, nanoseconds });
+        }
+        return entries;
+    }
+}
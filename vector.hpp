@@ -1,16 +1,32 @@
 #pragma once
 
+#include "bucket_index.hpp"
+#include "bucket_storage.hpp"
+#include "trace.hpp"
+
 #include <algorithm>
+#include <cmath>
 #include <cstddef> // for std::size_t
 #include <cstdint>
+#include <cstring>
+#include <exception>
 #include <functional>
 #include <initializer_list>
 #include <iterator>
-#include <list>
+#include <limits>
 #include <memory>
+#include <span>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <iostream>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <xmmintrin.h>
+#endif
+
 namespace usu
 {
     template <typename T>
@@ -32,14 +48,35 @@ namespace usu
     template <typename T>
     concept Vector = Array<T> && BeginEnd<T>;
 
-    template <typename T, std::size_t BucketCapacity = 10>
+    // Where a vector's bytes go, as reported by memory_usage(). Allocator rounding is not included, so the figures are a lower bound.
+    struct memory_breakdown
+    {
+        std::size_t elements = 0;        // slots holding elements
+        std::size_t unused_slots = 0;    // empty slots in linked buckets, including the inline bucket
+        std::size_t bucket_metadata = 0; // the vector object itself, heap bucket headers and their storage bookkeeping
+        std::size_t index = 0;           // nodes allocated by the index policy
+        std::size_t free_buckets = 0;    // emptied buckets kept on the free list for reuse
+        std::size_t storage_reserve = 0; // held by the storage policy but not yet handed to any bucket, such as unused huge-page region space
+
+        std::size_t total() const { return elements + unused_slots + bucket_metadata + index + free_buckets + storage_reserve; }
+    };
+
+    // Index selects how buckets are found by position: flat_index walks the bucket chain, tree_index<Fanout> keeps a counted B+-tree over it.
+    // Storage selects where heap buckets live: heap_storage allocates each one separately, huge_page_storage carves them out of huge-page regions
+    template <typename T, std::size_t BucketCapacity = 10, std::size_t InlineCapacity = BucketCapacity, typename Index = flat_index, typename Storage = heap_storage>
     class vector
     {
+        static_assert(BucketCapacity >= 2, "a bucket must be able to split into two halves");
+        static_assert(InlineCapacity >= 1 && InlineCapacity <= BucketCapacity, "the inline bucket must fit in a heap bucket when it splits");
+        class Bucket;
+
         public:
             using size_type = std::size_t;
             using reference = T&;
             using pointer = std::shared_ptr<T[]>;
 
+            // Walks the buckets directly rather than looking every position up, prefetching ahead each time it enters a new bucket.
+            // Like any bucket-based container, inserting or removing elements invalidates outstanding iterators.
             class iterator
             {
                 public:
@@ -47,30 +84,27 @@ namespace usu
                     using difference_type = std::ptrdiff_t;
 
                     iterator() :
-                        iterator(nullptr)
-                    {
-                    }
-
-                    iterator(const iterator& obj) :
-                        m_pos(obj.m_pos),
-                        m_data(obj.m_data)
-                    {
-                    }
-
-                    iterator(pointer data) :
                         m_pos(0),
-                        m_data(data)
+                        m_bucket(nullptr),
+                        m_offset(0),
+                        m_prefetchDistance(0)
                     {
                     }
 
-                    iterator(size_type pos, vector<T>& data) :
+                    iterator(const iterator& obj) = default;
+                    iterator& operator=(const iterator& obj) = default;
+
+                    // 'offset' is the position inside 'bucket'; an end iterator sits one past the last element of the last bucket
+                    iterator(size_type pos, Bucket* bucket, size_type offset, size_type prefetchDistance) :
                         m_pos(pos),
-                        m_data(data)
+                        m_bucket(bucket),
+                        m_offset(offset),
+                        m_prefetchDistance(prefetchDistance)
                     {
                     }
 
-                    reference operator*() const { return m_data[m_pos]; }
-                    auto* operator->() const { return &m_data[m_pos]; }
+                    reference operator*() const { return m_bucket->at(m_offset); }
+                    auto* operator->() const { return &m_bucket->at(m_offset); }
 
                     iterator& operator++();
                     iterator operator++(int);
@@ -82,12 +116,104 @@ namespace usu
 
                 private:
                     size_type m_pos;
-                    vector<T>& m_data;
-                };
+                    Bucket* m_bucket;
+                    size_type m_offset;
+                    size_type m_prefetchDistance;
+            };
+
+            // A forward range over the vector's storage as std::spans, one per contiguous run of elements: a bucket yields
+            // one span, or two when its ring wraps around the end of its storage. Empty buckets yield nothing.
+            template <typename Element>
+            class segment_range
+            {
+                public:
+                    class iterator
+                    {
+                        public:
+                            using iterator_category = std::forward_iterator_tag;
+                            using difference_type = std::ptrdiff_t;
+                            using value_type = std::span<Element>;
+
+                            iterator(const Bucket* bucket = nullptr, size_type prefetchDistance = 0) :
+                                m_bucket(skipEmpty(bucket)),
+                                m_wrapped(false),
+                                m_prefetchDistance(prefetchDistance)
+                            {
+                                Bucket::prefetchAhead(m_bucket, m_prefetchDistance);
+                            }
+
+                            std::span<Element> operator*() const
+                            {
+                                size_type head = m_bucket->getHead();
+                                size_type firstRun = std::min(m_bucket->getSize(), m_bucket->getCapacity() - head);
+                                Element* data = m_bucket->getData().get();
+                                return m_wrapped ? std::span<Element>(data, m_bucket->getSize() - firstRun) : std::span<Element>(data + head, firstRun);
+                            }
+
+                            iterator& operator++()
+                            {
+                                if (!m_wrapped && m_bucket->getHead() + m_bucket->getSize() > m_bucket->getCapacity())
+                                {
+                                    m_wrapped = true;
+                                }
+                                else
+                                {
+                                    m_bucket = skipEmpty(m_bucket->getNext());
+                                    m_wrapped = false;
+                                    Bucket::prefetchAhead(m_bucket, m_prefetchDistance);
+                                }
+                                return *this;
+                            }
+
+                            iterator operator++(int)
+                            {
+                                iterator temp = *this;
+                                ++(*this);
+                                return temp;
+                            }
+
+                            bool operator==(const iterator& other) const { return m_bucket == other.m_bucket && m_wrapped == other.m_wrapped; }
+                            bool operator!=(const iterator& other) const { return !(*this == other); }
+
+                        private:
+                            static const Bucket* skipEmpty(const Bucket* bucket)
+                            {
+                                while (bucket != nullptr && bucket->getSize() == 0)
+                                {
+                                    bucket = bucket->getNext();
+                                }
+                                return bucket;
+                            }
+
+                            const Bucket* m_bucket;
+                            bool m_wrapped; // on the second run of a wrapped bucket
+                            size_type m_prefetchDistance;
+                    };
+
+                    segment_range(const Bucket* first, size_type prefetchDistance) :
+                        m_first(first),
+                        m_prefetchDistance(prefetchDistance)
+                    {
+                    }
+
+                    iterator begin() const { return iterator(m_first, m_prefetchDistance); }
+                    iterator end() const { return iterator(); }
+
+                private:
+                    const Bucket* m_first;
+                    size_type m_prefetchDistance;
+            };
 
             vector();
             vector(size_type size);
+            vector(size_type size, const T& value);
             vector(std::initializer_list<T> list);
+            vector(const vector& other);
+            vector(vector&& other);
+            ~vector();
+
+            vector& operator=(const vector& other);
+            vector& operator=(vector&& other);
 
             reference operator[](size_type index);
             void add(T value);
@@ -96,283 +222,1496 @@ namespace usu
             void clear();
             void map(std::function<void(T&)> func);
 
+            // replace the contents with 'size' elements, laying out full buckets first and then filling them on 'threads' threads
+            // (0 picks one per core for large sizes); the generator receives the global index and must be safe to call concurrently.
+            // If the generator or starting a thread throws, the vector is left empty and the first exception is rethrown
+            template <typename Generator>
+            void generate(size_type size, Generator generator, size_type threads = 0);
+            void fill(size_type size, const T& value, size_type threads = 0);
+
+            void push_front(T value);
+            void pop_front();
+            void pop_back();
+
+            // apply many positional inserts/removes in one walk over the buckets; the result is the same as calling
+            // insert/remove for each entry in order, so every index refers to the vector as left by the entries before it
+            void insert_batch(std::vector<std::pair<size_type, T>> inserts);
+            void remove_batch(const std::vector<size_type>& indices);
+
+            // these move whole buckets between vectors: only the bucket at the boundary is split, everything else is relinked
+            void splice(size_type index, vector& other);
+            void append(vector&& other);
+            vector split_at(size_type index);
+
             size_type size() const { return m_size; }
             size_type capacity() const { return m_capacity; }
 
-            iterator begin() { return iterator(0, *this); }
-            iterator end() { return iterator(m_size, *this); }
+            // with a budget, every add/insert/remove/pop also spends up to 'budget' element moves topping buckets up from their successors
+            // until each bucket but the last is at least 'fill' full, so fragmentation is repaired without a stop-the-world pass; 0 turns it off
+            void set_compaction(size_type budget, double fill = 0.75);
+            // packs every bucket full in one pass
+            void compact();
+
+            memory_breakdown memory_usage() const;
+            // entry k is the number of heap buckets holding exactly k elements, for k = 0 .. BucketCapacity
+            std::vector<size_type> fill_histogram() const;
+
+            iterator begin();
+            iterator end() { return iterator(m_size, m_lastBucket, m_lastBucket->getSize(), m_prefetchDistance); }
+
+            segment_range<T> segments() { return segment_range<T>(&m_firstBucket, m_prefetchDistance); }
+            segment_range<const T> segments() const { return segment_range<const T>(&m_firstBucket, m_prefetchDistance); }
+
+            // how many buckets ahead map, iterators and segments() prefetch headers when they move to the next bucket; elements are
+            // prefetched one bucket closer, so 1 only prefetches the next header and 0 turns prefetching off
+            size_type prefetch_distance() const { return m_prefetchDistance; }
+            void set_prefetch_distance(size_type distance) { m_prefetchDistance = distance; }
+
+            // logs add/insert/remove/operator[]/pop_front/pop_back to 'recorder' until detached with nullptr; copies and moves do not inherit it.
+            // Attaching logs the current size, and the bulk operations (clear, assignment, generate/fill, the batches, splice, split_at)
+            // log only the size they leave behind, so a replay can rebuild a container of that size and carry on
+            void set_trace(trace_recorder* recorder);
 
         private:
-            class Bucket
+            // Each bucket is a ring buffer: element 0 lives at the head offset and the elements wrap around the end of the storage,
+            // so inserting or removing at either end of a bucket never shifts anything
+            class Bucket : public Index::hook
             {
                 public:
-                    Bucket(size_type capacity = BucketCapacity)
+                    Bucket(std::shared_ptr<T[]> data, size_type capacity) :
+                        m_bucketData(std::move(data)),
+                        m_bucketHead(0),
+                        m_bucketSize(0),
+                        m_bucketCapacity(capacity)
+                    {
+                    }
+
+                    // wraps storage owned by someone else (the vector's inline buffer) using an empty-owner aliasing pointer, so no allocation happens
+                    Bucket(T* storage, size_type capacity) :
+                        m_bucketData(std::shared_ptr<T[]>(), storage),
+                        m_bucketHead(0),
+                        m_bucketSize(0),
+                        m_bucketCapacity(capacity)
                     {
-                        m_bucketData = std::make_shared<T[]>(capacity);
-                        m_bucketSize = 0;
                     }
-                   
+
                     const std::shared_ptr<T[]>& getData() const { return m_bucketData; }
+                    size_type getHead() const { return m_bucketHead; }
                     size_type getSize() const { return m_bucketSize; }
+                    size_type getCapacity() const { return m_bucketCapacity; }
                     void setSize(size_type newSize) { m_bucketSize = newSize; }
                     void setValueAtIndex(size_type index, const T& value);
+                    void reset();
+                    // resets positions [from, from + count) to T() once their elements have left, so the slots stop holding resources
+                    void clearSlots(size_type from, size_type count);
+
+                    // maps a position in the bucket to its slot in getData()
+                    size_type physical(size_type index) const
+                    {
+                        index += m_bucketHead;
+                        return index >= m_bucketCapacity ? index - m_bucketCapacity : index;
+                    }
+                    T& at(size_type index) const { return m_bucketData[physical(index)]; }
+
+                    void insertAt(size_type index, T value);
+                    void removeAt(size_type index);
+                    void moveOut(size_type from, size_type count, T* destination);
+                    void copyOut(T* destination) const;
+
+                    // calls func(pointer, count) for the (at most two) contiguous runs holding positions [from, from + count)
+                    template <typename Func>
+                    void forEachRun(size_type from, size_type count, Func&& func) const;
+
+                    Bucket* getNext() const { return m_next; }
+                    Bucket* getPrev() const { return m_prev; }
+                    void setNext(Bucket* next) { m_next = next; }
+                    void setPrev(Bucket* prev) { m_prev = prev; }
+
+                    // called on entering 'bucket': starts loading the header 'distance' buckets ahead and the elements of the bucket
+                    // 'distance - 1' ahead, whose header an earlier step already requested; the index finds that bucket, so
+                    // tree_index does not chase every link to get there
+                    static void prefetchAhead(const Bucket* bucket, size_type distance);
 
                 private:
+                    void moveWithin(size_type to, size_type from, size_type count);
+
                     std::shared_ptr<T[]> m_bucketData;
+                    size_type m_bucketHead;
                     size_type m_bucketSize;
+                    size_type m_bucketCapacity;
+                    Bucket* m_next = nullptr;
+                    Bucket* m_prev = nullptr;
+            };
+
+            // emptied buckets kept for reuse by later splits, so request-scoped vectors stop churning the heap
+            static constexpr size_type FreeBucketLimit = 64;
+            // generate() only spreads over more threads when each one gets at least this many elements
+            static constexpr size_type ParallelGrain = 1 << 14;
+
+            Bucket* createBucket();
+            void destroyBucket(Bucket* bucket);
+            void deleteBuckets(Bucket* bucket);
+            void linkAfter(Bucket* position, Bucket* bucket);
+            void unlink(Bucket* bucket);
+            void releaseHeapBuckets();
+            void layOut(size_type size);
+            void copyFrom(const vector& other);
+            void stealFrom(vector& other);
+            static void moveElements(T* destination, T* source, size_type count);
+            static void copyElements(T* destination, const T* source, size_type count);
+
+            static size_type claimFreeSlot(std::vector<size_type>& taken, size_type rank);
+            static void prefetch(const void* address);
+
+            Bucket* findBucket(size_type& index);
+            Bucket* findInsertBucket(size_type& index);
+            Bucket* splitBucket(Bucket* bucket, size_type at);
+            void bucketShrunk(Bucket* bucket);
+            void mergeSparse(Bucket* bucket);
+            void rebuildIndex();
+            void traceReset();
+            // the incremental pass: compact() runs one on the stack, set_compaction() keeps one alive between operations
+            struct CompactionState
+            {
+                size_type budget = 0;
+                double fill = 1.0;
+                Bucket* cursor = nullptr; // the bucket the pass is topping up, nullptr to start a new pass
+                bool moved = false;       // whether the current pass has moved anything yet
+                bool idle = false;        // a whole pass moved nothing; set back when a bucket drops below the target
             };
-            std::list<std::shared_ptr<Bucket>> buckets;
+
+            void compactSome(CompactionState& state, size_type budget);
+            size_type compactionTarget(const Bucket* bucket, double fill) const;
+            void wakeCompaction(const Bucket* bucket);
+            void restartCompaction();
+            void compactAfterOperation();
+
+            // the first bucket lives inside the vector object itself, so small vectors never touch the heap; it is always the head of the bucket chain
+            T m_inlineData[InlineCapacity];
+            Bucket m_firstBucket;
+            Bucket* m_lastBucket;
+            Bucket* m_freeBuckets = nullptr; // singly linked through getNext()
+            size_type m_freeBucketCount = 0;
             size_type m_size; // the number of elements in the vector (NOT the number of buckets)
-            size_type m_capacity = BucketCapacity; // the total capacity of the vector, including all bucket space
+            size_type m_capacity = InlineCapacity; // the total capacity of the vector, including all bucket space
+            [[no_unique_address]] typename Index::template type<Bucket> m_index;
+            [[no_unique_address]] typename Storage::template type<T, BucketCapacity> m_storage;
+            size_type m_prefetchDistance = 1;
+            trace_recorder* m_trace = nullptr;
+            std::unique_ptr<CompactionState> m_compaction; // nullptr while incremental compaction is off
     };
 
-    template <typename T, std::size_t BucketCapacity>
-    vector<T, BucketCapacity>::vector() :
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    vector<T, BucketCapacity, InlineCapacity, Index, Storage>::vector() :
+        m_inlineData(),
+        m_firstBucket(m_inlineData, InlineCapacity),
+        m_lastBucket(&m_firstBucket),
         m_size(0)
     {
-        auto initialBucket = std::make_shared<Bucket>();
-        buckets.push_back(initialBucket);
+        rebuildIndex();
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    vector<T, BucketCapacity, InlineCapacity, Index, Storage>::vector(size_type size) :
+        vector()
+    {
+        layOut(size);
     }
 
-    template <typename T, std::size_t BucketCapacity>
-    vector<T, BucketCapacity>::vector(size_type size) :
-        m_size(size),
-        m_capacity(0)
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    vector<T, BucketCapacity, InlineCapacity, Index, Storage>::vector(size_type size, const T& value) :
+        vector()
     {
-        size_type numberOfBuckets = (size + BucketCapacity - 1) / BucketCapacity;
+        fill(size, value);
+    }
 
-        for (size_type i = 0; i < numberOfBuckets; ++i) 
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    vector<T, BucketCapacity, InlineCapacity, Index, Storage>::vector(std::initializer_list<T> list) :
+        vector()
+    {
+        for (const auto& value : list)
         {
-            auto bucket = std::make_shared<Bucket>();
-            bucket->setSize(BucketCapacity);
-            buckets.push_back(bucket);
-            m_capacity += BucketCapacity;
+            add(value);
         }
     }
 
-    template <typename T, std::size_t BucketCapacity>
-    vector<T, BucketCapacity>::vector(std::initializer_list<T> list) :
-        m_size(0)
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    vector<T, BucketCapacity, InlineCapacity, Index, Storage>::vector(const vector& other) :
+        vector()
     {
-        auto initialBucket = std::make_shared<Bucket>();
-        buckets.push_back(initialBucket);
-        for (const auto& value : list)
+        copyFrom(other);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    vector<T, BucketCapacity, InlineCapacity, Index, Storage>::vector(vector&& other) :
+        vector()
+    {
+        stealFrom(other);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    vector<T, BucketCapacity, InlineCapacity, Index, Storage>::~vector()
+    {
+        deleteBuckets(m_firstBucket.getNext());
+        deleteBuckets(m_freeBuckets);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    vector<T, BucketCapacity, InlineCapacity, Index, Storage>& vector<T, BucketCapacity, InlineCapacity, Index, Storage>::operator=(const vector& other)
+    {
+        if (this != &other)
         {
-            add(value);
+            clear();
+            copyFrom(other);
+            traceReset();
+        }
+        return *this;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    vector<T, BucketCapacity, InlineCapacity, Index, Storage>& vector<T, BucketCapacity, InlineCapacity, Index, Storage>::operator=(vector&& other)
+    {
+        if (this != &other)
+        {
+            clear();
+            stealFrom(other);
+            traceReset();
         }
+        return *this;
     }
 
-    template <typename T, std::size_t BucketCapacity>
-    typename vector<T, BucketCapacity>::reference vector<T, BucketCapacity>::operator[](size_type index)
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::reference vector<T, BucketCapacity, InlineCapacity, Index, Storage>::operator[](size_type index)
     {
         if (index >= m_size)
         {
             throw std::range_error("Index out of bounds");
         }
-
-        auto bucketIt = buckets.begin();
-        while (bucketIt != buckets.end() && index >= (*bucketIt)->getSize())
+        if (m_trace != nullptr)
         {
-            index -= (*bucketIt)->getSize();
-            ++bucketIt;
+            m_trace->record(trace_op::access, index);
         }
 
-        if (bucketIt == buckets.end())
+        auto bucket = findBucket(index);
+        if (bucket == nullptr)
         {
             throw std::range_error("Index out of bounds");
         }
 
-        return (*bucketIt)->getData().get()[index];
+        return bucket->at(index);
     }
 
-    template <typename T, std::size_t BucketCapacity>
-    void vector<T, BucketCapacity>::add(T value)
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::add(T value)
     {
-        auto& lastBucket = buckets.back();
-        if (lastBucket->getSize() == BucketCapacity)
+        if (m_trace != nullptr)
         {
-            size_type mid = BucketCapacity / 2;
-            // set the size of the original 'lastBucket' to mid, so the remaining elements will be overridden
-            lastBucket->setSize(mid);
-            // copy the second half of the bucket to a new 'secondHalfBucket'
-            auto secondHalfBucket = std::make_shared<Bucket>(BucketCapacity);
-            std::copy(lastBucket->getData().get() + mid, lastBucket->getData().get() + BucketCapacity, secondHalfBucket->getData().get());
-            secondHalfBucket->setSize(mid + 1);
-            // add new element to secondHalfBucket and append bucket to list of buckets
-            secondHalfBucket->setValueAtIndex(mid, value);
-            buckets.push_back(secondHalfBucket);
-            m_capacity += BucketCapacity;
+            m_trace->record(trace_op::add, m_size);
         }
-        else
+        auto lastBucket = m_lastBucket;
+        if (lastBucket->getSize() == lastBucket->getCapacity())
         {
-            size_type currentSize = lastBucket->getSize();
-            lastBucket->setValueAtIndex(currentSize, value);
-            lastBucket->setSize(currentSize + 1);
+            // the new element goes into the second half of the split
+            lastBucket = splitBucket(lastBucket, lastBucket->getSize() / 2);
         }
+        size_type currentSize = lastBucket->getSize();
+        lastBucket->setValueAtIndex(currentSize, value);
+        lastBucket->setSize(currentSize + 1);
+        m_index.update(lastBucket);
         m_size++;
+        compactAfterOperation();
     }
 
-    template <typename T, std::size_t BucketCapacity>
-    void vector<T, BucketCapacity>::insert(size_type index, T value)
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::insert(size_type index, T value)
     {
         if (index > m_size)
         {
             throw std::range_error("Invalid insert index");
         }
+        if (m_trace != nullptr)
+        {
+            m_trace->record(trace_op::insert, index);
+        }
+
+        size_type offset = index;
+        auto bucket = findInsertBucket(offset);
+        if (bucket == nullptr)
+        {
+            throw std::range_error("Index out of bounds");
+        }
 
-        bool inserted = false;
-        auto bucketIt = buckets.begin();
-        size_type count = 0;
-        while (bucketIt != buckets.end() && !inserted)
+        if (bucket->getSize() == bucket->getCapacity())
         {
-            size_type bucketSize = (*bucketIt)->getSize();
-            if (index <= count + bucketSize)
+            // determine if the new value should be inserted in the orignal (first) bucket or the second bucket
+            size_type mid = bucket->getSize() / 2;
+            auto secondHalfBucket = splitBucket(bucket, mid);
+            if (offset >= mid)
             {
-                if (bucketSize == BucketCapacity)
+                bucket = secondHalfBucket;
+                offset -= mid;
+            }
+        }
+
+        bucket->insertAt(offset, std::move(value));
+        m_index.update(bucket);
+        m_size++;
+        compactAfterOperation();
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::remove(size_type index)
+    {
+        if (index >= m_size)
+        {
+            throw std::range_error("Index out of range");
+        }
+        if (m_trace != nullptr)
+        {
+            m_trace->record(trace_op::remove, index);
+        }
+
+        // find the correct bucket
+        auto bucket = findBucket(index);
+        if (bucket == nullptr)
+        {
+            throw std::range_error("Element to remove not found");
+        }
+
+        bucket->removeAt(index);
+        m_size--;
+        bucketShrunk(bucket);
+        compactAfterOperation();
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::clear()
+    {
+        releaseHeapBuckets();
+        m_firstBucket.reset();
+        rebuildIndex();
+        m_size = 0;
+        traceReset();
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void usu::vector<T, BucketCapacity, InlineCapacity, Index, Storage>::map(std::function<void(T&)> func)
+    {
+        for (auto bucket = &m_firstBucket; bucket != nullptr; bucket = bucket->getNext())
+        {
+            Bucket::prefetchAhead(bucket, m_prefetchDistance);
+            bucket->forEachRun(0, bucket->getSize(), [&func](T* data, size_type count)
                 {
-                    size_type mid = BucketCapacity / 2;
-                    // adjust the size of the original bucket
-                    (*bucketIt)->setSize(mid);
+                    for (size_type i = 0; i < count; ++i)
+                    {
+                        func(data[i]);
+                    }
+                });
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    template <typename Generator>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::generate(size_type size, Generator generator, size_type threads)
+    {
+        clear();
+        layOut(size);
+        traceReset();
+
+        // every bucket with the global index of its first element, so each thread can work on its share independently
+        std::vector<std::pair<Bucket*, size_type>> buckets;
+        size_type start = 0;
+        for (auto bucket = &m_firstBucket; bucket != nullptr && start < size; bucket = bucket->getNext())
+        {
+            buckets.emplace_back(bucket, start);
+            start += bucket->getSize();
+        }
+
+        size_type workers = threads;
+        if (workers == 0)
+        {
+            workers = std::min<size_type>(std::max(1u, std::thread::hardware_concurrency()), (size + ParallelGrain - 1) / ParallelGrain);
+        }
+        workers = std::max<size_type>(1, std::min(workers, buckets.size()));
 
-                    // move the second half of the elements to the secondHalfBucket
-                    auto secondHalfBucket = std::make_shared<Bucket>(BucketCapacity);
-                    std::copy((*bucketIt)->getData().get() + mid, (*bucketIt)->getData().get() + BucketCapacity, secondHalfBucket->getData().get());
-                    secondHalfBucket->setSize(mid);
+        auto populate = [&buckets, &generator](size_type first, size_type last)
+        {
+            for (size_type i = first; i < last; i++)
+            {
+                auto [bucket, offset] = buckets[i];
+                for (size_type position = 0; position < bucket->getSize(); position++)
+                {
+                    bucket->at(position) = generator(offset + position);
+                }
+            }
+        };
 
-                    // determine if the new value should be inserted in the orignal (first) bucket or the second bucket
-                    if (index - count < mid)
+        // the calling thread takes the first share; the first exception from any share is rethrown once all have finished
+        std::vector<std::exception_ptr> errors(workers);
+        std::vector<std::thread> pool;
+        try
+        {
+            for (size_type worker = 1; worker < workers; worker++)
+            {
+                pool.emplace_back([&, worker]()
                     {
-                        for (size_type i = mid; i > index - count; --i)
+                        try
                         {
-                            (*bucketIt)->getData().get()[i] = (*bucketIt)->getData().get()[i - 1];
+                            populate(buckets.size() * worker / workers, buckets.size() * (worker + 1) / workers);
                         }
-                        (*bucketIt)->getData().get()[index - count] = value;
-                        (*bucketIt)->setSize(mid + 1);
-                    }
-                    else
-                    {
-                        size_type newIndex = index - count - mid;
-                        for (size_type i = (BucketCapacity - mid); i > newIndex; --i)
+                        catch (...)
                         {
-                            secondHalfBucket->getData().get()[i] = secondHalfBucket->getData().get()[i - 1];
+                            errors[worker] = std::current_exception();
                         }
-                        secondHalfBucket->getData().get()[newIndex] = value;
-                        secondHalfBucket->setSize(mid + 1);
-                    }
-                    // insert the new bucket after the bucket iterator
-                    buckets.insert(std::next(bucketIt), secondHalfBucket);
-                    m_capacity += BucketCapacity;
-                }
-                else
-                {
-                    // handle the case where the bucket is not full
-                    for (size_type i = bucketSize; i > index - count; --i)
-                    {
-                        (*bucketIt)->setValueAtIndex(i, (*bucketIt)->getData()[i - 1]);
-                    }
-                    (*bucketIt)->setValueAtIndex(index - count, value);
-                    (*bucketIt)->setSize(bucketSize + 1);
-                }
-                m_size++;
-                inserted = true;
+                    });
             }
-            count += bucketSize;
-            ++bucketIt;
+            populate(0, buckets.size() / workers);
+        }
+        catch (...)
+        {
+            errors[0] = std::current_exception();
+        }
+        for (auto& thread : pool)
+        {
+            thread.join();
         }
 
-        if (!inserted)
+        // recycled buckets and the inline buffer still hold whatever they held before, so a partly populated layout is not kept
+        for (auto& error : errors)
         {
-            throw std::range_error("Index out of bounds");
+            if (error)
+            {
+                clear();
+                std::rethrow_exception(error);
+            }
         }
     }
 
-    template <typename T, std::size_t BucketCapacity>
-    void vector<T, BucketCapacity>::remove(size_type index)
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::fill(size_type size, const T& value, size_type threads)
     {
-        if (index >= m_size)
+        generate(size, [&value](size_type) { return value; }, threads);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::push_front(T value)
+    {
+        insert(0, std::move(value));
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::pop_front()
+    {
+        if (m_size == 0)
         {
-            throw std::range_error("Index out of range");
+            throw std::range_error("Cannot pop from an empty vector");
         }
-
-        // find the correct bucket
-        auto bucketIt = buckets.begin();
-        while (bucketIt != buckets.end() && index >= (*bucketIt)->getSize())
+        if (m_trace != nullptr)
         {
-            index -= (*bucketIt)->getSize();
-            ++bucketIt;
+            m_trace->record(trace_op::pop_front, 0);
         }
+        // only the inline bucket can be empty, so the front element is in it or in the bucket right after it
+        auto bucket = m_firstBucket.getSize() > 0 ? &m_firstBucket : m_firstBucket.getNext();
+        bucket->removeAt(0);
+        m_size--;
+        bucketShrunk(bucket);
+        compactAfterOperation();
+    }
 
-        if (bucketIt == buckets.end())
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::pop_back()
+    {
+        if (m_size == 0)
         {
-            throw std::range_error("Element to remove not found");
+            throw std::range_error("Cannot pop from an empty vector");
         }
-       
-        // shift elements left to fill the gap
-        for (size_type i = index; i < (*bucketIt)->getSize() - 1; ++i)
+        if (m_trace != nullptr)
         {
-            (*bucketIt)->setValueAtIndex(i, (*bucketIt)->getData()[i + 1]);
+            m_trace->record(trace_op::pop_back, m_size - 1);
         }
-        // decrease the size of the bucket
-        (*bucketIt)->setSize((*bucketIt)->getSize() - 1);
+        auto bucket = m_lastBucket;
+        bucket->removeAt(bucket->getSize() - 1);
         m_size--;
+        bucketShrunk(bucket);
+        compactAfterOperation();
     }
 
-    template <typename T, std::size_t BucketCapacity>
-    void vector<T, BucketCapacity>::clear()
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::insert_batch(std::vector<std::pair<size_type, T>> inserts)
     {
-        buckets.clear();
-        m_size = 0;
-    }
+        // validate everything up front so a bad index leaves the vector untouched
+        for (size_type i = 0; i < inserts.size(); i++)
+        {
+            if (inserts[i].first > m_size + i)
+            {
+                throw std::range_error("Invalid insert index");
+            }
+        }
 
-    template <typename T, std::size_t BucketCapacity>
-    void usu::vector<T, BucketCapacity>::map(std::function<void(T&)> func) 
-    {
-        for (auto& bucket : buckets) 
+        // work out where each value ends up: walking backwards, an insert lands on the index-th slot not already
+        // claimed by a later insert (later inserts shift it, earlier ones never do)
+        std::vector<std::pair<size_type, size_type>> placements; // (final position, entry in 'inserts')
+        placements.reserve(inserts.size());
+        std::vector<size_type> taken;
+        taken.reserve(inserts.size());
+        for (size_type i = inserts.size(); i > 0; i--)
+        {
+            placements.emplace_back(claimFreeSlot(taken, inserts[i - 1].first), i - 1);
+        }
+        std::sort(placements.begin(), placements.end());
+
+        // the n-th value in final order goes right before original element (final position - n)
+        size_type next = 0;
+        size_type start = 0;
+        std::vector<T> merged;
+        auto bucket = &m_firstBucket;
+        while (bucket != nullptr && next < placements.size())
         {
-            for (size_type i = 0; i < bucket->getSize(); ++i) 
+            auto following = bucket->getNext();
+            size_type bucketSize = bucket->getSize();
+            size_type end = start + bucketSize;
+            auto before = [&](size_type original) { return next < placements.size() && placements[next].first - next <= original; };
+            bool owned = following == nullptr ? before(end) : before(end - 1) && bucketSize > 0;
+
+            if (owned)
             {
-                func(bucket->getData().get()[i]);
+                // rebuild this bucket in one pass, spreading the result over as many buckets as it needs
+                merged.clear();
+                for (size_type i = 0; i < bucketSize; i++)
+                {
+                    while (before(start + i))
+                    {
+                        merged.push_back(std::move(inserts[placements[next++].second].second));
+                    }
+                    merged.push_back(std::move(bucket->at(i)));
+                }
+                while (following == nullptr && next < placements.size())
+                {
+                    merged.push_back(std::move(inserts[placements[next++].second].second));
+                }
+
+                // the bucket's old elements were all moved into 'merged', so it is refilled from scratch
+                size_type position = 0;
+                auto target = bucket;
+                target->reset();
+                while (true)
+                {
+                    size_type remaining = merged.size() - position;
+                    size_type bucketsLeft = (remaining + BucketCapacity - 1) / BucketCapacity;
+                    size_type count = std::min(target->getCapacity(), (remaining + bucketsLeft - 1) / bucketsLeft);
+                    target->reset();
+                    moveElements(target->getData().get(), merged.data() + position, count);
+                    target->setSize(count);
+                    position += count;
+                    if (position == merged.size())
+                    {
+                        break;
+                    }
+                    auto extra = createBucket();
+                    linkAfter(target, extra);
+                    target = extra;
+                }
             }
+            start = end;
+            bucket = following;
         }
+        rebuildIndex();
+        m_size += inserts.size();
+        traceReset();
     }
 
-    template <typename T, std::size_t BucketCapacity>
-    typename vector<T, BucketCapacity>::iterator& vector<T, BucketCapacity>::iterator::operator++()
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::remove_batch(const std::vector<size_type>& indices)
     {
-        ++m_pos;
-        return *this;
-    }
+        for (size_type i = 0; i < indices.size(); i++)
+        {
+            if (indices[i] + i >= m_size)
+            {
+                throw std::range_error("Index out of range");
+            }
+        }
 
-    template <typename T, std::size_t BucketCapacity>
-    typename vector<T, BucketCapacity>::iterator vector<T, BucketCapacity>::iterator::operator++(int)
-    {
-        iterator temp = *this;
-        ++(*this);
-        return temp;
+        // walking forwards, a remove hits the index-th original element not already removed by an earlier entry
+        std::vector<size_type> removed;
+        removed.reserve(indices.size());
+        for (auto index : indices)
+        {
+            claimFreeSlot(removed, index);
+        }
+
+        size_type next = 0;
+        size_type start = 0;
+        auto bucket = &m_firstBucket;
+        while (bucket != nullptr && next < removed.size())
+        {
+            auto following = bucket->getNext();
+            size_type bucketSize = bucket->getSize();
+            if (removed[next] < start + bucketSize)
+            {
+                // compact the survivors of this bucket in one pass
+                size_type kept = 0;
+                for (size_type i = 0; i < bucketSize; i++)
+                {
+                    if (next < removed.size() && removed[next] == start + i)
+                    {
+                        next++;
+                    }
+                    else
+                    {
+                        if (kept != i)
+                        {
+                            bucket->at(kept) = std::move(bucket->at(i));
+                        }
+                        kept++;
+                    }
+                }
+                bucket->clearSlots(kept, bucketSize - kept);
+                bucket->setSize(kept);
+                if (kept == 0 && bucket != &m_firstBucket)
+                {
+                    unlink(bucket);
+                    destroyBucket(bucket);
+                }
+            }
+            start += bucketSize;
+            bucket = following;
+        }
+        rebuildIndex();
+        m_size -= removed.size();
+        traceReset();
     }
 
-    template <typename T, std::size_t BucketCapacity>
-    typename vector<T, BucketCapacity>::iterator& vector<T, BucketCapacity>::iterator::operator--()
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::splice(size_type index, vector& other)
     {
-        --m_pos;
-        return *this;
+        if (&other == this)
+        {
+            throw std::invalid_argument("Cannot splice a vector into itself");
+        }
+        if (index > m_size)
+        {
+            throw std::range_error("Invalid splice index");
+        }
+        if (other.m_size == 0)
+        {
+            return;
+        }
+
+        // find the bucket the other buckets get linked after, splitting the one bucket that straddles 'index'
+        size_type offset = index;
+        auto position = findInsertBucket(offset);
+        if (offset < position->getSize())
+        {
+            splitBucket(position, offset);
+        }
+
+        // the other vector's inline elements cannot be relinked, so they are the only ones copied
+        if (other.m_firstBucket.getSize() > 0)
+        {
+            auto bucket = createBucket();
+            other.m_firstBucket.moveOut(0, other.m_firstBucket.getSize(), bucket->getData().get());
+            bucket->setSize(other.m_firstBucket.getSize());
+            other.m_firstBucket.reset();
+            linkAfter(position, bucket);
+            position = bucket;
+        }
+
+        auto first = other.m_firstBucket.getNext();
+        if (first != nullptr)
+        {
+            auto last = other.m_lastBucket;
+            auto next = position->getNext();
+            position->setNext(first);
+            first->setPrev(position);
+            last->setNext(next);
+            if (next != nullptr)
+            {
+                next->setPrev(last);
+            }
+            else
+            {
+                m_lastBucket = last;
+            }
+            m_capacity += other.m_capacity - InlineCapacity;
+        }
+
+        m_size += other.m_size;
+        other.m_firstBucket.setNext(nullptr);
+        other.m_lastBucket = &other.m_firstBucket;
+        other.m_size = 0;
+        other.m_capacity = InlineCapacity;
+        rebuildIndex();
+        other.rebuildIndex();
+        traceReset();
+        other.traceReset();
     }
 
-    template <typename T, std::size_t BucketCapacity>
-    typename vector<T, BucketCapacity>::iterator vector<T, BucketCapacity>::iterator::operator--(int)
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::append(vector&& other)
     {
-        iterator temp = *this;
-        --(*this);
-        return temp;
+        splice(m_size, other);
     }
 
-    template <typename T, std::size_t BucketCapacity>
-    void vector<T, BucketCapacity>::Bucket::setValueAtIndex(size_type index, const T& value)
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    vector<T, BucketCapacity, InlineCapacity, Index, Storage> vector<T, BucketCapacity, InlineCapacity, Index, Storage>::split_at(size_type index)
     {
-        if (index > m_bucketSize)
+        if (index > m_size)
         {
-            throw std::range_error("Index out of bounds");
+            throw std::range_error("Invalid split index");
+        }
+
+        vector tail;
+        if (index == m_size)
+        {
+            return tail;
+        }
+
+        // find the first bucket that moves to the tail, splitting the one bucket that straddles 'index'
+        size_type offset = index;
+        auto first = findInsertBucket(offset);
+        if (offset == first->getSize())
+        {
+            first = first->getNext();
+        }
+        else if (offset > 0 || first == &m_firstBucket)
+        {
+            first = splitBucket(first, offset);
+        }
+
+        auto last = m_lastBucket;
+        m_lastBucket = first->getPrev();
+        m_lastBucket->setNext(nullptr);
+        tail.m_firstBucket.setNext(first);
+        first->setPrev(&tail.m_firstBucket);
+        tail.m_lastBucket = last;
+
+        size_type movedCapacity = 0;
+        for (auto bucket = first; bucket != nullptr; bucket = bucket->getNext())
+        {
+            movedCapacity += bucket->getCapacity();
+        }
+        m_capacity -= movedCapacity;
+        tail.m_capacity += movedCapacity;
+        tail.m_size = m_size - index;
+        m_size = index;
+        rebuildIndex();
+        tail.rebuildIndex();
+        traceReset();
+        return tail;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket* vector<T, BucketCapacity, InlineCapacity, Index, Storage>::createBucket()
+    {
+        m_capacity += BucketCapacity;
+        if (m_freeBuckets != nullptr)
+        {
+            auto bucket = m_freeBuckets;
+            m_freeBuckets = bucket->getNext();
+            m_freeBucketCount--;
+            bucket->setNext(nullptr);
+            return bucket;
+        }
+        return new Bucket(m_storage.allocate(), BucketCapacity);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::destroyBucket(Bucket* bucket)
+    {
+        if (m_compaction != nullptr && bucket == m_compaction->cursor)
+        {
+            m_compaction->cursor = nullptr;
+        }
+        m_capacity -= bucket->getCapacity();
+        if (m_freeBucketCount == FreeBucketLimit)
+        {
+            delete bucket;
+            return;
+        }
+        bucket->reset();
+        bucket->setNext(m_freeBuckets);
+        m_freeBuckets = bucket;
+        m_freeBucketCount++;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::deleteBuckets(Bucket* bucket)
+    {
+        while (bucket != nullptr)
+        {
+            auto next = bucket->getNext();
+            delete bucket;
+            bucket = next;
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::linkAfter(Bucket* position, Bucket* bucket)
+    {
+        bucket->setPrev(position);
+        bucket->setNext(position->getNext());
+        if (position->getNext() != nullptr)
+        {
+            position->getNext()->setPrev(bucket);
+        }
+        else
+        {
+            m_lastBucket = bucket;
+        }
+        position->setNext(bucket);
+        m_index.insertAfter(position, bucket);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::unlink(Bucket* bucket)
+    {
+        // the inline bucket is never unlinked, so every bucket passed in here has a predecessor
+        m_index.erase(bucket);
+        bucket->getPrev()->setNext(bucket->getNext());
+        if (bucket->getNext() != nullptr)
+        {
+            bucket->getNext()->setPrev(bucket->getPrev());
+        }
+        else
+        {
+            m_lastBucket = bucket->getPrev();
+        }
+        bucket->setNext(nullptr);
+        bucket->setPrev(nullptr);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::layOut(size_type size)
+    {
+        // on an empty vector: fill the inline bucket first, then as many full heap buckets as needed, leaving any remainder in the last one
+        size_type remaining = size;
+        size_type inlineCount = std::min(remaining, InlineCapacity);
+        m_firstBucket.setSize(inlineCount);
+        m_index.update(&m_firstBucket);
+        remaining -= inlineCount;
+
+        while (remaining > 0)
+        {
+            auto bucket = createBucket();
+            size_type count = std::min(remaining, BucketCapacity);
+            bucket->setSize(count);
+            linkAfter(m_lastBucket, bucket);
+            remaining -= count;
+        }
+        m_size = size;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::releaseHeapBuckets()
+    {
+        auto bucket = m_firstBucket.getNext();
+        while (bucket != nullptr)
+        {
+            auto next = bucket->getNext();
+            destroyBucket(bucket);
+            bucket = next;
+        }
+        m_firstBucket.setNext(nullptr);
+        m_lastBucket = &m_firstBucket;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::copyFrom(const vector& other)
+    {
+        // copy bucket by bucket so the copy has the same layout as the original
+        other.m_firstBucket.copyOut(m_inlineData);
+        m_firstBucket.setSize(other.m_firstBucket.getSize());
+        m_index.update(&m_firstBucket);
+        for (auto source = other.m_firstBucket.getNext(); source != nullptr; source = source->getNext())
+        {
+            auto bucket = createBucket();
+            source->copyOut(bucket->getData().get());
+            bucket->setSize(source->getSize());
+            linkAfter(m_lastBucket, bucket);
+        }
+        m_size = other.m_size;
+        m_prefetchDistance = other.m_prefetchDistance;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::stealFrom(vector& other)
+    {
+        // the inline elements have to be moved one by one, but the heap buckets are simply relinked
+        other.m_firstBucket.moveOut(0, other.m_firstBucket.getSize(), m_inlineData);
+        m_firstBucket.setSize(other.m_firstBucket.getSize());
+
+        auto firstHeapBucket = other.m_firstBucket.getNext();
+        if (firstHeapBucket != nullptr)
+        {
+            m_firstBucket.setNext(firstHeapBucket);
+            firstHeapBucket->setPrev(&m_firstBucket);
+            m_lastBucket = other.m_lastBucket;
+        }
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+        m_prefetchDistance = other.m_prefetchDistance;
+
+        other.m_firstBucket.setNext(nullptr);
+        other.m_firstBucket.setSize(0);
+        other.m_lastBucket = &other.m_firstBucket;
+        other.m_size = 0;
+        other.m_capacity = InlineCapacity;
+
+        // swap the indexes and point the moved one at this vector's inline bucket; both callers leave this vector empty first,
+        // so 'other' receives a single-bucket index, and rebuilding that is cheaper and safer than a second replace, which
+        // would find the parent the first one just gave m_firstBucket and undo it
+        m_index.swap(other.m_index);
+        m_index.replace(&other.m_firstBucket, &m_firstBucket);
+        other.rebuildIndex();
+
+        // the moved buckets keep their regions alive on their own, but later buckets should come from the same regions
+        std::swap(m_storage, other.m_storage);
+        restartCompaction();
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::moveElements(T* destination, T* source, size_type count)
+    {
+        // the ranges may overlap (shifting inside a bucket), so pick the direction that never overwrites unread elements
+        if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            if (count > 0)
+            {
+                std::memmove(destination, source, count * sizeof(T));
+            }
+        }
+        else if (destination < source)
+        {
+            std::move(source, source + count, destination);
+        }
+        else
+        {
+            std::move_backward(source, source + count, destination + count);
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::copyElements(T* destination, const T* source, size_type count)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            if (count > 0)
+            {
+                std::memcpy(destination, source, count * sizeof(T));
+            }
+        }
+        else
+        {
+            std::copy(source, source + count, destination);
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::prefetch(const void* address)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+        (void)address;
+#endif
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::size_type vector<T, BucketCapacity, InlineCapacity, Index, Storage>::claimFreeSlot(std::vector<size_type>& taken, size_type rank)
+    {
+        // finds the rank-th slot not listed in the sorted 'taken' list and adds it there; taken[i] - i counts the free slots before
+        // taken[i], so the answer sits right before the first taken slot with more than 'rank' free slots in front of it
+        size_type low = 0;
+        size_type high = taken.size();
+        while (low < high)
+        {
+            size_type mid = (low + high) / 2;
+            if (taken[mid] - mid > rank)
+            {
+                high = mid;
+            }
+            else
+            {
+                low = mid + 1;
+            }
+        }
+        size_type slot = rank + low;
+        taken.insert(taken.begin() + static_cast<std::ptrdiff_t>(low), slot);
+        return slot;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket* vector<T, BucketCapacity, InlineCapacity, Index, Storage>::findBucket(size_type& index)
+    {
+        // returns the bucket holding 'index' and leaves 'index' as the position inside that bucket
+        return m_index.find(&m_firstBucket, index);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket* vector<T, BucketCapacity, InlineCapacity, Index, Storage>::findInsertBucket(size_type& index)
+    {
+        // like findBucket, but a position right past the end of a bucket belongs to that bucket rather than the next one
+        return m_index.findInsert(&m_firstBucket, index);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket* vector<T, BucketCapacity, InlineCapacity, Index, Storage>::splitBucket(Bucket* bucket, size_type at)
+    {
+        // move the elements from 'at' onward into a new bucket linked right after this one
+        auto secondHalfBucket = createBucket();
+        bucket->moveOut(at, bucket->getSize() - at, secondHalfBucket->getData().get());
+        secondHalfBucket->setSize(bucket->getSize() - at);
+        // set the size of the original bucket to 'at', so the remaining elements will be overridden
+        bucket->setSize(at);
+        m_index.update(bucket);
+        linkAfter(bucket, secondHalfBucket);
+        wakeCompaction(bucket);
+        wakeCompaction(secondHalfBucket);
+        return secondHalfBucket;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::bucketShrunk(Bucket* bucket)
+    {
+        // an emptied heap bucket goes back to the free list; the inline bucket always stays in place
+        if (bucket->getSize() == 0 && bucket != &m_firstBucket)
+        {
+            unlink(bucket);
+            destroyBucket(bucket);
+            return;
+        }
+        m_index.update(bucket);
+        wakeCompaction(bucket);
+        if constexpr (Index::merges_buckets)
+        {
+            mergeSparse(bucket);
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::mergeSparse(Bucket* bucket)
+    {
+        // fold a bucket that dropped below a quarter full into a neighbour that has room for its elements
+        if (bucket->getSize() * 4 >= bucket->getCapacity())
+        {
+            return;
+        }
+
+        auto target = bucket->getPrev();
+        auto source = bucket;
+        if (target == nullptr || target->getSize() + source->getSize() > target->getCapacity())
+        {
+            target = bucket;
+            source = bucket->getNext();
+            if (source == nullptr || target->getSize() + source->getSize() > target->getCapacity())
+            {
+                return;
+            }
+        }
+
+        for (size_type i = 0; i < source->getSize(); i++)
+        {
+            target->insertAt(target->getSize(), std::move(source->at(i)));
+        }
+        source->reset();
+        unlink(source);
+        destroyBucket(source);
+        m_index.update(target);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::set_trace(trace_recorder* recorder)
+    {
+        m_trace = recorder;
+        traceReset();
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::traceReset()
+    {
+        if (m_trace != nullptr)
+        {
+            m_trace->record(trace_op::reset, m_size);
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::rebuildIndex()
+    {
+        // whatever relinked the buckets may have taken the compaction cursor's bucket along
+        m_index.rebuild(&m_firstBucket);
+        restartCompaction();
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::set_compaction(size_type budget, double fill)
+    {
+        if (fill <= 0.0 || fill > 1.0)
+        {
+            throw std::invalid_argument("The compaction fill factor must be in (0, 1]");
+        }
+        if (budget == 0)
+        {
+            m_compaction.reset();
+            return;
+        }
+        if (m_compaction == nullptr)
+        {
+            m_compaction = std::make_unique<CompactionState>();
+        }
+        m_compaction->budget = budget;
+        m_compaction->fill = fill;
+        restartCompaction();
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::compact()
+    {
+        // a fresh pass with no budget limit leaves every bucket but the last one full
+        CompactionState pass;
+        compactSome(pass, std::numeric_limits<size_type>::max());
+        restartCompaction();
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::restartCompaction()
+    {
+        if (m_compaction != nullptr)
+        {
+            m_compaction->cursor = nullptr;
+            m_compaction->idle = false;
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::compactAfterOperation()
+    {
+        if (m_compaction != nullptr && !m_compaction->idle)
+        {
+            compactSome(*m_compaction, m_compaction->budget);
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::size_type vector<T, BucketCapacity, InlineCapacity, Index, Storage>::compactionTarget(const Bucket* bucket, double fill) const
+    {
+        return std::min(bucket->getCapacity(), static_cast<size_type>(std::ceil(fill * static_cast<double>(bucket->getCapacity()))));
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::wakeCompaction(const Bucket* bucket)
+    {
+        // an idle incremental pass only has work again once some bucket falls below the target
+        if (m_compaction != nullptr && bucket->getSize() < compactionTarget(bucket, m_compaction->fill))
+        {
+            m_compaction->idle = false;
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::compactSome(CompactionState& state, size_type budget)
+    {
+        // each unit of budget is one element moved or one bucket stepped over, so the work per call is bounded however fragmented the vector is
+        while (budget > 0 && !state.idle)
+        {
+            if (state.cursor == nullptr)
+            {
+                state.cursor = &m_firstBucket;
+                state.moved = false;
+            }
+            auto bucket = state.cursor;
+            auto next = bucket->getNext();
+            if (next == nullptr)
+            {
+                // end of the pass: if it moved nothing, every bucket already meets the target and there is nothing to do until one changes
+                state.idle = !state.moved;
+                state.cursor = nullptr;
+                budget--;
+                continue;
+            }
+
+            auto target = compactionTarget(bucket, state.fill);
+            if (bucket->getSize() >= target)
+            {
+                state.cursor = next;
+                budget--;
+                continue;
+            }
+
+            // pull elements off the front of the next bucket, which the ring buffer makes O(1) each
+            size_type count = std::min({ target - bucket->getSize(), next->getSize(), budget });
+            for (size_type i = 0; i < count; i++)
+            {
+                bucket->insertAt(bucket->getSize(), std::move(next->at(0)));
+                next->removeAt(0);
+            }
+            budget -= count;
+            state.moved = true;
+            m_index.update(bucket);
+            if (next->getSize() == 0)
+            {
+                unlink(next);
+                destroyBucket(next);
+            }
+            else
+            {
+                m_index.update(next);
+            }
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    memory_breakdown vector<T, BucketCapacity, InlineCapacity, Index, Storage>::memory_usage() const
+    {
+        constexpr size_type heapBucketOverhead = sizeof(Bucket) + Storage::template type<T, BucketCapacity>::OverheadBytes;
+
+        memory_breakdown usage;
+        // the inline slots are part of the vector object, so they are counted as slots rather than as metadata
+        usage.bucket_metadata = sizeof(vector) - sizeof(m_inlineData);
+        for (auto bucket = &m_firstBucket; bucket != nullptr; bucket = bucket->getNext())
+        {
+            usage.elements += bucket->getSize() * sizeof(T);
+            usage.unused_slots += (bucket->getCapacity() - bucket->getSize()) * sizeof(T);
+            if (bucket != &m_firstBucket)
+            {
+                usage.bucket_metadata += heapBucketOverhead;
+            }
+        }
+        for (auto bucket = m_freeBuckets; bucket != nullptr; bucket = bucket->getNext())
+        {
+            usage.free_buckets += heapBucketOverhead + bucket->getCapacity() * sizeof(T);
+        }
+        usage.index = m_index.memoryBytes();
+        usage.storage_reserve = m_storage.reservedBytes();
+        return usage;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    std::vector<typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::size_type> vector<T, BucketCapacity, InlineCapacity, Index, Storage>::fill_histogram() const
+    {
+        std::vector<size_type> histogram(BucketCapacity + 1, 0);
+        for (auto bucket = m_firstBucket.getNext(); bucket != nullptr; bucket = bucket->getNext())
+        {
+            histogram[bucket->getSize()]++;
+        }
+        return histogram;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::iterator vector<T, BucketCapacity, InlineCapacity, Index, Storage>::begin()
+    {
+        // the inline bucket is the only one that can be empty while later buckets hold elements
+        auto first = &m_firstBucket;
+        if (first->getSize() == 0 && first->getNext() != nullptr)
+        {
+            first = first->getNext();
+        }
+        Bucket::prefetchAhead(first, m_prefetchDistance);
+        return iterator(0, first, 0, m_prefetchDistance);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::iterator& vector<T, BucketCapacity, InlineCapacity, Index, Storage>::iterator::operator++()
+    {
+        ++m_pos;
+        // heap buckets are never empty, so the next one always holds the following element; the last bucket keeps the end position
+        if (++m_offset == m_bucket->getSize() && m_bucket->getNext() != nullptr)
+        {
+            m_bucket = m_bucket->getNext();
+            m_offset = 0;
+            Bucket::prefetchAhead(m_bucket, m_prefetchDistance);
+        }
+        return *this;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::iterator vector<T, BucketCapacity, InlineCapacity, Index, Storage>::iterator::operator++(int)
+    {
+        iterator temp = *this;
+        ++(*this);
+        return temp;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::iterator& vector<T, BucketCapacity, InlineCapacity, Index, Storage>::iterator::operator--()
+    {
+        --m_pos;
+        if (m_offset > 0)
+        {
+            --m_offset;
+            return *this;
+        }
+        // only the inline bucket can be empty, and nothing comes before it
+        m_bucket = m_bucket->getPrev();
+        m_offset = m_bucket->getSize() - 1;
+        return *this;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    typename vector<T, BucketCapacity, InlineCapacity, Index, Storage>::iterator vector<T, BucketCapacity, InlineCapacity, Index, Storage>::iterator::operator--(int)
+    {
+        iterator temp = *this;
+        --(*this);
+        return temp;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket::setValueAtIndex(size_type index, const T& value)
+    {
+        if (index > m_bucketSize)
+        {
+            throw std::range_error("Index out of bounds");
+        }
+        at(index) = value;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket::reset()
+    {
+        // release whatever the old elements hold on to (strings, pointers) before the bucket is reused
+        clearSlots(0, m_bucketSize);
+        m_bucketHead = 0;
+        m_bucketSize = 0;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket::clearSlots(size_type from, size_type count)
+    {
+        if constexpr (!std::is_trivially_destructible_v<T>)
+        {
+            forEachRun(from, count, [](T* data, size_type runLength) { std::fill(data, data + runLength, T()); });
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket::insertAt(size_type index, T value)
+    {
+        // shift whichever side of 'index' is shorter; the front side moves into the slot before the head
+        if (index < m_bucketSize - index)
+        {
+            m_bucketHead = m_bucketHead == 0 ? m_bucketCapacity - 1 : m_bucketHead - 1;
+            moveWithin(0, 1, index);
+        }
+        else
+        {
+            moveWithin(index + 1, index, m_bucketSize - index);
+        }
+        m_bucketSize++;
+        at(index) = std::move(value);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket::removeAt(size_type index)
+    {
+        // close the gap from whichever side is shorter
+        if (index < m_bucketSize - index - 1)
+        {
+            moveWithin(1, 0, index);
+            clearSlots(0, 1);
+            m_bucketHead = m_bucketHead + 1 == m_bucketCapacity ? 0 : m_bucketHead + 1;
+        }
+        else
+        {
+            moveWithin(index, index + 1, m_bucketSize - index - 1);
+            clearSlots(m_bucketSize - 1, 1);
+        }
+        m_bucketSize--;
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket::moveWithin(size_type to, size_type from, size_type count)
+    {
+        // shifts positions [from, from + count) to [to, to + count) one contiguous chunk at a time, walking
+        // in the direction that never overwrites elements that have not been moved yet
+        T* data = m_bucketData.get();
+        if (to < from)
+        {
+            while (count > 0)
+            {
+                size_type source = physical(from);
+                size_type destination = physical(to);
+                size_type chunk = std::min({ count, m_bucketCapacity - source, m_bucketCapacity - destination });
+                moveElements(data + destination, data + source, chunk);
+                from += chunk;
+                to += chunk;
+                count -= chunk;
+            }
+        }
+        else
+        {
+            while (count > 0)
+            {
+                size_type sourceEnd = physical(from + count - 1) + 1;
+                size_type destinationEnd = physical(to + count - 1) + 1;
+                size_type chunk = std::min({ count, sourceEnd, destinationEnd });
+                moveElements(data + destinationEnd - chunk, data + sourceEnd - chunk, chunk);
+                count -= chunk;
+            }
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket::moveOut(size_type from, size_type count, T* destination)
+    {
+        forEachRun(from, count, [&destination](T* data, size_type runLength)
+            {
+                moveElements(destination, data, runLength);
+                destination += runLength;
+            });
+        clearSlots(from, count);
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket::copyOut(T* destination) const
+    {
+        forEachRun(0, m_bucketSize, [&destination](T* data, size_type runLength)
+            {
+                copyElements(destination, data, runLength);
+                destination += runLength;
+            });
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    template <typename Func>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket::forEachRun(size_type from, size_type count, Func&& func) const
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        size_type start = physical(from);
+        size_type firstRun = std::min(count, m_bucketCapacity - start);
+        func(m_bucketData.get() + start, firstRun);
+        if (firstRun < count)
+        {
+            func(m_bucketData.get(), count - firstRun);
+        }
+    }
+
+    template <typename T, std::size_t BucketCapacity, std::size_t InlineCapacity, typename Index, typename Storage>
+    void vector<T, BucketCapacity, InlineCapacity, Index, Storage>::Bucket::prefetchAhead(const Bucket* bucket, size_type distance)
+    {
+        if (bucket == nullptr || distance == 0)
+        {
+            return;
+        }
+        // the header of the bucket 'distance - 1' ahead was requested on the previous step, so reading its data pointer
+        // and next link is cheap; at distance 1 that bucket is the current one and only the next header is prefetched
+        auto nearer = Index::template type<Bucket>::ahead(bucket, distance - 1);
+        if (nearer == nullptr)
+        {
+            return;
+        }
+        if (distance >= 2)
+        {
+            prefetch(nearer->m_bucketData.get() + nearer->physical(0));
+        }
+        auto farthest = nearer->getNext();
+        if (farthest != nullptr)
+        {
+            prefetch(farthest);
         }
-        m_bucketData[index] = value;
     }
 }
\ No newline at end of file